@@ -1,234 +1,890 @@
-#include <iostream>
-#include <vector>
-#include <string>
-#include <climits>
-#include <cstdlib>
-#include <ctime>
-#include <sstream>
-#include <random>
-
-using namespace std;
-
-// Structure to represent a city
-struct City {
-    string name;
-    vector<pair<int, int>> connections; // pair represents (city_index, flight_duration)
-};
+#include "FINAL.h"
+
+// Function to time the solvers on fixed workloads and compare against a baseline file.
+// Each workload is timed right after a fixed calibration workload, and the baseline holds the
+// median of their ratios, so a machine that is slower or busier overall does not show up as a
+// regression. The baseline is tracked in the repository next to this file and only rewritten
+// when recording is asked for; a run fails on a slowdown beyond tolerance or a workload the
+// baseline does not list.
+int runRegressionBenchmark(const string& baselineFile, double tolerance, bool recording) {
+    MonotonicArena arena;
+    const int numCities = 100000;
+    RouteGraph graph = buildRouteGraph(arena, numCities, generateRandomRoutes(numCities, 3, 42));
+    MonotonicArena smallArena;
+    RouteGraph small = buildRouteGraph(smallArena, 2000, generateRandomRoutes(2000, 3, 42));
+    MonotonicArena denseArena;
+    RouteGraph dense = buildRouteGraph(denseArena, 400, generateRandomRoutes(400, 20, 42));
+    HubLabels labels;
+    labels.build(small);
+    vector<int> sources, targets;
+    for (int i = 0; i < 20; i++) {
+        sources.push_back(i * 1999 % numCities);
+        targets.push_back(i * 7919 % numCities);
+    }
+    vector<int> tableSources(sources.begin(), sources.begin() + 4);
+
+    // Calibration: scattered reads and a sort, the same mix of memory traffic and arithmetic
+    // the solvers do, but no solver code
+    vector<int> chain(1 << 20);
+    mt19937 rng(1);
+    for (int& next : chain) {
+        next = rng() % chain.size();
+    }
+    volatile long long sink = 0; // Keeps results from being optimized away
+    auto calibrate = [&]() {
+        long long sum = 0;
+        for (int i = 0, at = 0; i < int(chain.size()); i++) {
+            at = chain[at];
+            sum += at;
+        }
+        vector<int> sorted(chain.begin(), chain.begin() + (1 << 18));
+        sort(sorted.begin(), sorted.end());
+        sink = sum + sorted[sorted.size() / 2];
+    };
 
-// Function to generate a random airport name
-string generateRandomAirportName() {
-    string airportNames[30] = {
-        "Visakhapatnam (VTZ)",
-        "Vijayawada (VGA)",
-        "Guwahati (GAU)",
-        "Muzaffarpur (MZU)",
-        "Bilaspur (PAB)",
-        "Raipur (RPR)",
-        "Ahmedabad (AMD)",
-        "Rajkot (HSR)",
-        "Kullu-Manali (KUU)",
-        "Shimla (SLV)",
-        "Ranchi (IXR)",
-        "Bengaluru (BLR)",
-        "Mangaluru (IXE)",
-        "Kochi (COK)",
-        "Thiruvananthapuram (TRV)",
-        "Bhopal (BHO)",
-        "Mumbai (BOM)",
-        "Nagpur (NAG)",
-        "Shirdi (SAG)",
-        "Imphal (IMF)",
-        "Shillong (SHL)",
-        "Bhuvaneshwar (BBI)",
-        "Amritsar (ATQ)",
-        "Jaipur (JAI)",
-        "Chennai (MAA)",
-        "Coimbatore (CJB)",
-        "Hyderabad (HYD)",
-        "Delhi-NCR (DEL)",
-        "Kolkata (CCU)",
-        "Srinagar (SXR)"
+    // Solvers run on one thread, so the number of idle cores does not change the timings
+    vector<pair<string, function<void()>>> workloads = {
+        {"dijkstra", [&]() { vector<int> prev(2000, -1); dijkstra(small, 0, 1, prev); }},
+        {"deltaStepping", [&]() { vector<int> prev(numCities, -1); deltaStepping(graph, 0, prev, 1); }},
+        {"manyToMany", [&]() { manyToMany(graph, tableSources, targets, 1); }},
+        {"floydWarshall", [&]() { floydWarshall<int, uint16_t>(dense); }},
+        {"hubLabelsBuild", [&]() { HubLabels built; built.build(small); }},
+        {"hubLabelsQuery", [&]() { for (int q = 0; q < 100000; q++) sink = labels.distance(q % 2000, q * 7 % 2000); }},
+        {"reachableWithin", [&]() { for (int origin : sources) reachableWithin(graph, origin, 360); }}
     };
-    static bool usedIndices[30] = {false}; // Track used indices
-    int numAirportNames = sizeof(airportNames)/sizeof(airportNames[0]);
 
-    int randomIndex;
-    do {
-        randomIndex = rand() % numAirportNames;
-    } while (usedIndices[randomIndex]); // Ensure it's not a used index
+    map<string, double> baseline;
+    ifstream in(baselineFile);
+    string line;
+    while (getline(in, line)) {
+        istringstream fields(line);
+        string name;
+        double ratio;
+        if (line.empty() || line[0] == '#' || !(fields >> name >> ratio)) {
+            continue;
+        }
+        baseline[name] = ratio;
+    }
+    if (!recording && baseline.empty()) {
+        cout << "No baseline in " << baselineFile << "; record one with --bench regression-record" << endl;
+        return 1;
+    }
 
-    usedIndices[randomIndex] = true;
-    return airportNames[randomIndex];
-}
-// Function to generate a random flight name
-string generateRandomFlightName() {
-    static const string airlines[] = {
-        "Delta Air Lines",
-        "American Airlines",
-        "United Airlines",
-        "Southwest Airlines",
-        "Emirates",
-        "Air China",
-        "British Airways",
-        "Japan Airlines",
-        "Qantas",
-        "Lufthansa"
+    int numRegressions = 0;
+    ofstream out;
+    if (recording) {
+        out.open(baselineFile);
+        out << "# Median over 7 runs of each workload's time over the calibration workload's, from FINAL --bench regression-record" << endl;
+        out << "# Re-record and commit alongside any change to the workloads or the calibration" << endl;
+    }
+    const int numRuns = 7;
+    auto timeMillis = [](const function<void()>& work) {
+        auto started = chrono::steady_clock::now();
+        work();
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
     };
+    calibrate(); // Warm up
+    for (auto& workload : workloads) {
+        vector<double> ratios, millis;
+        for (int run = 0; run < numRuns; run++) {
+            double calibration = timeMillis(calibrate);
+            millis.push_back(timeMillis(workload.second));
+            ratios.push_back(millis.back() / calibration);
+        }
+        sort(ratios.begin(), ratios.end());
+        sort(millis.begin(), millis.end());
+        double ratio = ratios[numRuns / 2];
+        cout << workload.first << ": " << millis[numRuns / 2] << " ms, " << ratio << "x calibration";
+        if (recording) {
+            out << workload.first << " " << ratio << endl;
+        } else if (baseline.count(workload.first) != 0) {
+            double limit = baseline[workload.first] * tolerance;
+            cout << " (baseline " << baseline[workload.first] << "x)";
+            if (ratio > limit) {
+                cout << " REGRESSION";
+                numRegressions++;
+            }
+        } else {
+            cout << " (no baseline)";
+            numRegressions++;
+        }
+        cout << endl;
+    }
+    if (recording) {
+        cout << "Recorded baseline in " << baselineFile << endl;
+    }
+    return numRegressions;
+}
+
+// Function to check weather and return safety status
+string checkWeather(int temperature) {
+    if (temperature > 40 || temperature < 0) {
+        return "UNSAFE";
+    } else {
+        return "SAFE";
+    }
+}
 
-    int numAirlines = sizeof(airlines) / sizeof(airlines[0]);
-    int randomAirlineIndex = rand() % numAirlines;
+// Function to check if the fuel is sufficient for the journey
+string checkFuel(int fuel) {
+    if (fuel >= 1500) {
+        return "Good to Go!";
+    } else {
+        return "INSUFFICIENT FUEL";
+    }
+}
+
+// One query as main reads it: origin and destination city, temperature and remaining fuel
+struct TraceQuery {
+    int origin;
+    int destination;
+    int temperature;
+    int fuel;
+};
 
-    string airportName = generateRandomAirportName();
+// Function to synthesize a query trace with Zipf-distributed airport popularity: the k-th most
+// popular airport is picked with weight 1/k^zipfExponent, in a random order of airports.
+// Temperatures and fuel are spread so a few queries fail checkWeather or checkFuel.
+vector<TraceQuery> generateTrace(int numCities, int numQueries, double zipfExponent, unsigned seed) {
+    mt19937 rng(seed);
+    vector<int> byPopularity(numCities);
+    for (int city = 0; city < numCities; city++) {
+        byPopularity[city] = city;
+    }
+    shuffle(byPopularity.begin(), byPopularity.end(), rng);
+    vector<double> weights(numCities);
+    for (int rank = 0; rank < numCities; rank++) {
+        weights[rank] = 1.0 / pow(rank + 1.0, zipfExponent);
+    }
+    discrete_distribution<int> popularAirport(weights.begin(), weights.end());
+    normal_distribution<double> temperature(18, 12);
+    uniform_int_distribution<int> fuel(800, 6000);
+
+    vector<TraceQuery> trace(numQueries);
+    for (auto& query : trace) {
+        query.origin = byPopularity[popularAirport(rng)];
+        query.destination = byPopularity[popularAirport(rng)];
+        query.temperature = int(lround(temperature(rng)));
+        query.fuel = fuel(rng);
+    }
+    return trace;
+}
 
-    ostringstream flightNameStream;
-    flightNameStream << airlines[randomAirlineIndex] << " Flight to " << airportName;
+// Function to write a trace as one "origin destination temperature fuel" line per query
+bool saveTrace(const vector<TraceQuery>& trace, const string& fileName) {
+    ofstream out(fileName);
+    for (const auto& query : trace) {
+        out << query.origin << " " << query.destination << " " << query.temperature << " " << query.fuel << "\n";
+    }
+    return bool(out);
+}
 
-    return flightNameStream.str();
+// Function to read a trace written by saveTrace, dropping queries for cities the network lacks
+vector<TraceQuery> loadTrace(const string& fileName, int numCities) {
+    vector<TraceQuery> trace;
+    ifstream in(fileName);
+    TraceQuery query;
+    while (in >> query.origin >> query.destination >> query.temperature >> query.fuel) {
+        if (query.origin >= 0 && query.origin < numCities && query.destination >= 0 && query.destination < numCities) {
+            trace.push_back(query);
+        }
+    }
+    return trace;
 }
 
-// Function to find the shortest path between two cities using Dijkstra's algorithm
-vector<int> dijkstra(vector<City>& cities, int start, int end, vector<int>& prev) {
-    int numCities = cities.size();
-    vector<int> distance(numCities, INT_MAX); // Initialize distances to infinity
-    vector<bool> visited(numCities, false); // Initialize visited array
+// Log-linear latency histogram in nanoseconds, HDR style: every power of two is split into
+// 128 equal sub-buckets, so any recorded value is known to within 1% in fixed memory
+class LatencyHistogram {
+public:
+    static const int subBucketBits = 7;
+    static const int subBuckets = 1 << subBucketBits;
+    static const int numBuckets = (64 - subBucketBits + 1) << subBucketBits;
 
-    distance[start] = 0; // Distance from start city to itself is 0
+    LatencyHistogram() : counts(numBuckets, 0) {}
 
-    for (int i = 0; i < numCities - 1; i++) {
-        int minDistance = INT_MAX;
-        int minIndex;
+    void record(uint64_t nanos) {
+        counts[bucketOf(nanos)]++;
+        total++;
+        largest = max(largest, nanos);
+    }
 
-        // Find the city with the minimum distance
-        for (int j = 0; j < numCities; j++) {
-            if (!visited[j] && distance[j] <= minDistance) {
-                minDistance = distance[j];
-                minIndex = j;
-            }
+    void merge(const LatencyHistogram& other) {
+        for (int b = 0; b < numBuckets; b++) {
+            counts[b] += other.counts[b];
         }
+        total += other.total;
+        largest = max(largest, other.largest);
+    }
 
-        visited[minIndex] = true; // Mark the city as visited
-
-        // Update the distances of the neighboring cities
-        for (const auto& connection : cities[minIndex].connections) {
-            int neighbor = connection.first;
-            int duration = connection.second;
-            if (!visited[neighbor] && distance[minIndex] != INT_MAX && distance[minIndex] + duration < distance[neighbor]) {
-                distance[neighbor] = distance[minIndex] + duration;
-                prev[neighbor] = minIndex;
+    // Smallest value that at least fraction of the recorded values do not exceed
+    uint64_t percentile(double fraction) const {
+        uint64_t wanted = max<uint64_t>(1, uint64_t(ceil(fraction * total)));
+        uint64_t seen = 0;
+        for (int b = 0; b < numBuckets; b++) {
+            seen += counts[b];
+            if (seen >= wanted) {
+                return min(highestInBucket(b), largest);
             }
         }
+        return largest;
     }
 
-    return distance;
-}
-
-// Function to find the shortest paths between all cities using Floyd-Warshall algorithm
-vector<vector<int>> floydWarshall(vector<City>& cities, vector<vector<int>>& prev) {
-    int numCities = cities.size();
-    vector<vector<int>> dist(numCities, vector<int>(numCities, INT_MAX));
+    uint64_t count() const {
+        return total;
+    }
+    uint64_t maximum() const {
+        return largest;
+    }
 
-    // Initialize distance matrix with direct connections
-    for (int i = 0; i < numCities; i++) {
-        dist[i][i] = 0;
-        for (const auto& connection : cities[i].connections) {
-            int neighbor = connection.first;
-            int duration = connection.second;
-            dist[i][neighbor] = duration;
-            prev[i][neighbor] = i;
+private:
+    // Values below 2 * subBuckets get a bucket each; above that the top 8 bits pick the bucket
+    static int bucketOf(uint64_t value) {
+        if (value < 2 * subBuckets) {
+            return int(value);
         }
+        int shift = 63 - __builtin_clzll(value) - subBucketBits;
+        return ((shift + 1) << subBucketBits) + int(value >> shift) - subBuckets;
     }
 
-    // Floyd-Warshall algorithm
-    for (int k = 0; k < numCities; k++) {
-        for (int i = 0; i < numCities; i++) {
-            for (int j = 0; j < numCities; j++) {
-                if (dist[i][k] != INT_MAX && dist[k][j] != INT_MAX && dist[i][k] + dist[k][j] < dist[i][j]) {
-                    dist[i][j] = dist[i][k] + dist[k][j];
-                    prev[i][j] = prev[k][j];
-                }
-            }
+    static uint64_t highestInBucket(int bucket) {
+        if (bucket < 2 * subBuckets) {
+            return bucket;
         }
+        int shift = (bucket >> subBucketBits) - 1;
+        uint64_t mantissa = (bucket & (subBuckets - 1)) + subBuckets;
+        return ((mantissa + 1) << shift) - 1;
     }
 
-    return dist;
-}
+    vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t largest = 0;
+};
 
-// Function to check weather and return safety status
-string checkWeather(int temperature) {
-    if (temperature > 40 || temperature < 0) {
-        return "UNSAFE";
-    } else {
-        return "SAFE";
+// Function to replay a trace against the published network from numThreads threads.
+// With a target rate the trace is open-loop: query i is due at i / targetQps seconds, and its
+// latency runs from when it was due, so time spent waiting behind a slow query is counted too.
+// A target of 0 sends queries back to back. Returns the merged latency histogram.
+LatencyHistogram replayTrace(const SnapshotStore& store, const vector<TraceQuery>& trace, double targetQps, int numThreads,
+                             long long& numGrounded, long long& checksum) {
+    vector<LatencyHistogram> histograms(numThreads);
+    vector<long long> grounded(numThreads, 0), sums(numThreads, 0);
+    auto started = chrono::steady_clock::now() + chrono::milliseconds(10); // Lets every thread get going first
+    vector<thread> workers;
+    for (int t = 0; t < numThreads; t++) {
+        workers.emplace_back([&, t]() {
+            for (size_t q = t; q < trace.size(); q += numThreads) {
+                auto due = chrono::steady_clock::now();
+                if (targetQps > 0) {
+                    due = started + chrono::nanoseconds(int64_t(q * 1e9 / targetQps));
+                    // Sleeping overshoots by tens of microseconds, so the last stretch spins
+                    this_thread::sleep_until(due - chrono::microseconds(100));
+                    while (chrono::steady_clock::now() < due) {
+                        this_thread::yield();
+                    }
+                }
+
+                const TraceQuery& query = trace[q];
+                if (checkWeather(query.temperature) != "SAFE" || checkFuel(query.fuel) != "Good to Go!") {
+                    grounded[t]++;
+                } else {
+                    // Every reader slot busy: wait for one, the delay counts towards latency
+                    for (;;) {
+                        SnapshotStore::ReadGuard snapshot = store.acquire();
+                        if (snapshot) {
+                            sums[t] += snapshot->labels.path(query.origin, query.destination).size();
+                            break;
+                        }
+                        this_thread::yield();
+                    }
+                }
+                histograms[t].record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - due).count());
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
     }
-}
 
-// Function to check if the fuel is sufficient for the journey
-string checkFuel(int fuel) {
-    if (fuel >= 1500) {
-        return "Good to Go!";
-    } else {
-        return "INSUFFICIENT FUEL";
+    LatencyHistogram merged;
+    numGrounded = checksum = 0;
+    for (int t = 0; t < numThreads; t++) {
+        merged.merge(histograms[t]);
+        numGrounded += grounded[t];
+        checksum += sums[t];
     }
+    return merged;
 }
 
 // Function to print the path from start to end city using Dijkstra
-void printDijkstraPath(vector<City>& cities, int start, int end, const vector<int>& prev) {
+void printDijkstraPath(const AirportCatalog& airports, int start, int end, const vector<int>& prev) {
     if (start != end && prev[end] != -1) {
-        printDijkstraPath(cities, start, prev[end], prev);
+        printDijkstraPath(airports, start, prev[end], prev);
         cout << " -> ";
     }
-    cout << cities[end].name;
+    cout << airports.name(end);
 }
 
 // Function to print the path from start to end city using Floyd-Warshall
-void printFloydWarshallPath(vector<City>& cities, int start, int end, const vector<vector<int>>& prev) {
-    if (start != end && prev[start][end] != -1) {
-        printFloydWarshallPath(cities, start, prev[start][end], prev);
+template <typename Weight, typename Index>
+void printFloydWarshallPath(const AirportCatalog& airports, int start, int end, const PathMatrix<Weight, Index>& paths) {
+    if (start != end && paths.predecessor(start, end) != -1) {
+        printFloydWarshallPath(airports, start, paths.predecessor(start, end), paths);
         cout << " -> ";
     }
-    cout << cities[end].name;
+    cout << airports.name(end);
 }
 
-int main() {
+// Function to read a numeric benchmark option, falling back to a default when it is missing
+// Function to read an airport as its 1-based city number or its IATA code, e.g. "HYD".
+// Returns 0 for input that is neither.
+int readCity(const AirportCatalog& airports) {
+    string input;
+    cin >> input;
+    int city = airports.findByCode(input);
+    return city >= 0 ? city + 1 : atoi(input.c_str());
+}
+
+int benchmarkOption(const vector<string>& args, size_t index, int fallback) {
+    return index < args.size() ? atoi(args[index].c_str()) : fallback;
+}
+
+// Function to run a named benchmark on generated networks instead of the interactive planner
+int runBenchmark(const vector<string>& args) {
+    const string& name = args[0];
+    if (name == "hub-labels") {
+        // hub-labels [numCities] [routesPerCity] [numQueries]
+        int numCities = benchmarkOption(args, 1, 5000);
+        MonotonicArena arena;
+        RouteGraph graph = buildRouteGraph(arena, numCities, generateRandomRoutes(numCities, benchmarkOption(args, 2, 3), 42));
+
+        auto started = chrono::steady_clock::now();
+        HubLabels labels;
+        labels.build(graph);
+        cout << "Built hub labels for " << numCities << " cities in "
+             << chrono::duration<double>(chrono::steady_clock::now() - started).count() << " s" << endl;
+
+        string fileName = "hub_labels.bin";
+        HubLabels mapped;
+        if (labels.save(fileName) && mapped.load(fileName)) {
+            reportHubLabels(graph, mapped, benchmarkOption(args, 3, 100000), 7);
+        } else {
+            cout << "Could not persist hub labels to " << fileName << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (name == "delta-scaling") {
+        // delta-scaling [numCities] [routesPerCity] [maxThreads]
+        int numCities = benchmarkOption(args, 1, 200000);
+        int maxThreads = benchmarkOption(args, 3, defaultThreadCount());
+        MonotonicArena arena;
+        RouteGraph graph = buildRouteGraph(arena, numCities, generateRandomRoutes(numCities, benchmarkOption(args, 2, 3), 42));
+
+        cout << "deltaStepping on " << numCities << " cities, " << defaultThreadCount() << " hardware threads" << endl;
+        vector<int> expected;
+        double oneThreadMillis = 0;
+        for (int threads = 1; threads <= maxThreads; threads = threads < maxThreads ? min(maxThreads, threads * 2) : threads + 1) {
+            double best = 1e18;
+            bool same = true;
+            for (int run = 0; run < 3; run++) {
+                vector<int> prev(numCities, -1);
+                auto started = chrono::steady_clock::now();
+                vector<int> distance = deltaStepping(graph, 0, prev, threads);
+                best = min(best, chrono::duration<double, milli>(chrono::steady_clock::now() - started).count());
+                if (expected.empty()) {
+                    expected = distance;
+                }
+                same = same && distance == expected;
+            }
+            if (threads == 1) {
+                oneThreadMillis = best;
+            }
+            cout << threads << " threads: " << best << " ms, speedup " << oneThreadMillis / best
+                 << (same ? "" : " (DISTANCES DIFFER)") << endl;
+        }
+        return 0;
+    }
+
+    if (name == "allocations") {
+        // allocations [numCities] [routesPerCity] [numRounds] [numThreads]
+        int numCities = benchmarkOption(args, 1, 100000);
+        int numRounds = benchmarkOption(args, 3, 5);
+        int numThreads = benchmarkOption(args, 4, max(2, defaultThreadCount()));
+        MonotonicArena arena;
+        RouteGraph graph = buildRouteGraph(arena, numCities, generateRandomRoutes(numCities, benchmarkOption(args, 2, 3), 42));
+        const AllocationStats& built = arena.allocationStats();
+        cout << "Route graph: " << built.allocations << " arena allocations (" << built.bytesRequested / 1024
+             << " KiB) served by " << built.systemAllocations << " system allocations (" << built.bytesReserved / 1024 << " KiB)" << endl;
+
+        // One round is a parallel many-to-many table plus single-thread searches. The first round
+        // fills the pools, which is what every parallel call paid when each had fresh threads.
+        vector<int> sources, targets;
+        for (int i = 0; i < 16; i++) {
+            sources.push_back(i * 1999 % numCities);
+            targets.push_back(i * 7919 % numCities);
+        }
+        for (int round = 1; round <= numRounds; round++) {
+            AllocationStats before = QueryPool::allThreadsStats();
+            auto started = chrono::steady_clock::now();
+            manyToMany(graph, sources, targets, numThreads);
+            for (int origin : sources) {
+                reachableWithin(graph, origin, 240);
+            }
+            double millis = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+            AllocationStats used = QueryPool::allThreadsStats() - before;
+            cout << "Round " << round << ": " << used.allocations << " pooled buffers (" << used.bytesRequested / 1024
+                 << " KiB), " << used.systemAllocations << " system allocations (" << used.bytesReserved / 1024
+                 << " KiB), " << millis << " ms" << endl;
+        }
+        return 0;
+    }
+
+    if (name == "reachable") {
+        // reachable [numCities] [routesPerCity] [budgetMinutes] [numOrigins]
+        int numCities = benchmarkOption(args, 1, 100000);
+        int budget = benchmarkOption(args, 3, 360);
+        int numOrigins = benchmarkOption(args, 4, 100);
+        MonotonicArena arena;
+        RouteGraph graph = buildRouteGraph(arena, numCities, generateRandomRoutes(numCities, benchmarkOption(args, 2, 3), 42));
+        mt19937 rng(7);
+        vector<int> origins(numOrigins);
+        for (int& origin : origins) {
+            origin = rng() % numCities;
+        }
+
+        // Today's approach: a full single-source search, then filter the distances
+        auto started = chrono::steady_clock::now();
+        size_t fullCount = 0;
+        for (int origin : origins) {
+            vector<int> distance = deltaStepping(graph, origin, DistanceOnly(), 1);
+            fullCount += count_if(distance.begin(), distance.end(), [&](int d) { return d <= budget; });
+        }
+        double fullMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+
+        started = chrono::steady_clock::now();
+        size_t boundedCount = 0;
+        for (int origin : origins) {
+            boundedCount += reachableWithin(graph, origin, budget).size();
+        }
+        double boundedMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+
+        started = chrono::steady_clock::now();
+        size_t batchCount = 0;
+        for (const auto& reachable : reachableWithinBatch(graph, origins, budget)) {
+            batchCount += reachable.size();
+        }
+        double batchMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+
+        cout << "Reachable within " << budget << " min from " << numOrigins << " origins (" << boundedCount << " cities in total)" << endl;
+        cout << "Full search + filter: " << fullMillis << " ms (" << fullCount << ")" << endl;
+        cout << "Bounded search: " << boundedMillis << " ms" << endl;
+        cout << "Batched bounded search on " << defaultThreadCount() << " threads: " << batchMillis << " ms (" << batchCount << ")" << endl;
+        return fullCount == boundedCount && batchCount == boundedCount ? 0 : 1;
+    }
+
+    if (name == "reorder") {
+        // reorder [numCities] [routesPerCity] [numQueries]
+        int numCities = benchmarkOption(args, 1, 500000);
+        int numQueries = benchmarkOption(args, 3, 10);
+        vector<pair<double, double>> locations;
+        vector<Route> routes = generateRegionalRoutes(numCities, benchmarkOption(args, 2, 4), 42, locations);
+        MonotonicArena arena;
+        RouteGraph graph = buildRouteGraph(arena, numCities, routes);
+        mt19937 rng(7);
+        vector<int> origins(numQueries);
+        for (int& origin : origins) {
+            origin = rng() % numCities;
+        }
+
+        const pair<CityOrder, const char*> methods[] = {
+            {CityOrder::Original, "original"},
+            {CityOrder::Bfs, "bfs"},
+            {CityOrder::ReverseCuthillMcKee, "rcm"},
+            {CityOrder::Hilbert, "hilbert"}
+        };
+        long long expectedChecksum = -1;
+        for (const auto& method : methods) {
+            ReorderedNetwork network = reorderNetwork(graph, computeCityOrder(graph, method.first, locations));
+            CacheMissCounter cacheMisses;
+            long long checksum = 0;
+            auto started = chrono::steady_clock::now();
+            cacheMisses.start();
+            for (int origin : origins) {
+                vector<int> distance = deltaStepping(network.graph, network.toInternal[origin], DistanceOnly(), 1);
+                for (int d : distance) {
+                    checksum += d == INT_MAX ? 0 : d;
+                }
+            }
+            long long misses = cacheMisses.stop();
+            double millis = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count() / max(1, numQueries);
+            if (expectedChecksum == -1) {
+                expectedChecksum = checksum;
+            }
+
+            cout << method.second << ": " << millis << " ms per query, cache misses "
+                 << (misses < 0 ? string("n/a") : to_string(misses / max(1, numQueries)))
+                 << (checksum == expectedChecksum ? "" : " (DISTANCES DIFFER)") << endl;
+        }
+        return 0;
+    }
+
+    if (name == "snapshots") {
+        // snapshots [numCities] [routesPerCity] [numReaders] [numReloads]
+        int numCities = benchmarkOption(args, 1, 10000);
+        int routesPerCity = benchmarkOption(args, 2, 3);
+        int numReaders = benchmarkOption(args, 3, max(1, defaultThreadCount() - 1)); // Leave a core for the writer
+        int numReloads = benchmarkOption(args, 4, 5);
+
+        AirportCatalog airports = generateAirportCatalog(numCities);
+        SnapshotStore store;
+        store.publish(buildSnapshot(airports, generateRandomRoutes(numCities, routesPerCity, 0), true));
+
+        // Readers answer hub label queries nonstop while the writer keeps replacing the network
+        atomic<bool> stop(false);
+        vector<long long> queries(numReaders, 0);
+        vector<double> worstMicros(numReaders, 0);
+        vector<thread> readers;
+        for (int r = 0; r < numReaders; r++) {
+            readers.emplace_back([&, r]() {
+                mt19937 rng(r);
+                while (!stop.load(memory_order_relaxed)) {
+                    auto started = chrono::steady_clock::now();
+                    SnapshotStore::ReadGuard snapshot = store.acquire();
+                    if (!snapshot) {
+                        continue; // More readers than slots: shed the query
+                    }
+                    snapshot->labels.distance(rng() % numCities, rng() % numCities);
+                    worstMicros[r] = max(worstMicros[r], chrono::duration<double, micro>(chrono::steady_clock::now() - started).count());
+                    queries[r]++;
+                }
+            });
+        }
+
+        auto started = chrono::steady_clock::now();
+        for (int reload = 1; reload <= numReloads; reload++) {
+            store.reloadInBackground([&, reload]() {
+                return buildSnapshot(airports, generateRandomRoutes(numCities, routesPerCity, reload), true);
+            }).join();
+        }
+        stop = true;
+        for (auto& reader : readers) {
+            reader.join();
+        }
+
+        long long totalQueries = 0;
+        double worst = 0;
+        for (int r = 0; r < numReaders; r++) {
+            totalQueries += queries[r];
+            worst = max(worst, worstMicros[r]);
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        cout << numReloads << " reloads in " << seconds << " s while " << numReaders << " readers ran "
+             << totalQueries << " queries" << endl;
+        store.waitForReclaim(chrono::milliseconds(1000));
+        cout << "Worst query latency: " << worst << " us, snapshots reclaimed: " << store.numReclaimed()
+             << " of " << numReloads << " (" << store.numPending() << " still pending)" << endl;
+        return store.numReclaimed() == size_t(numReloads) ? 0 : 1;
+    }
+
+    if (name == "regression" || name == "regression-record") {
+        // regression [baselineFile] [tolerancePercent], regression-record [baselineFile]
+        string baselineFile = args.size() > 1 ? args[1] : "Final/perf_baseline.txt";
+        return runRegressionBenchmark(baselineFile, 1 + benchmarkOption(args, 2, 30) / 100.0, name == "regression-record") == 0 ? 0 : 1;
+    }
+
+    if (name == "all-pairs") {
+        // all-pairs [numCities] [routesPerCity] [fileName]
+        int numCities = benchmarkOption(args, 1, 2000);
+        string fileName = args.size() > 3 ? args[3] : "all_pairs.bin";
+        MappedAllPairs<int, uint16_t> table;
+        if (!PathMatrix<int, uint16_t>::fits(numCities)) {
+            cout << "16-bit predecessors hold at most " << PathMatrix<int, uint16_t>::noCity << " cities" << endl;
+            return 1;
+        }
+
+        // Reuse a table a previous run left behind for this same network; pay for Floyd-Warshall only when there is none
+        MonotonicArena arena;
+        RouteGraph graph = buildRouteGraph(arena, numCities, generateRandomRoutes(numCities, benchmarkOption(args, 2, 3), 42));
+        uint64_t fingerprint = networkFingerprint(graph);
+        auto started = chrono::steady_clock::now();
+        if (table.open(fileName, fingerprint)) {
+            cout << "Mapped " << fileName << " and verified its checksums in "
+                 << chrono::duration<double, milli>(chrono::steady_clock::now() - started).count() << " ms" << endl;
+        } else {
+            if (!saveAllPairs(floydWarshall<int, uint16_t>(graph), fingerprint, fileName) || !table.open(fileName, fingerprint)) {
+                cout << "Could not persist the all-pairs table to " << fileName << endl;
+                return 1;
+            }
+            cout << "Computed and saved " << fileName << " in "
+                 << chrono::duration<double, milli>(chrono::steady_clock::now() - started).count() << " ms" << endl;
+        }
+
+        mt19937 rng(7);
+        const int numQueries = 1000000;
+        long long checksum = 0;
+        started = chrono::steady_clock::now();
+        for (int q = 0; q < numQueries; q++) {
+            checksum += table.distance(rng() % numCities, rng() % numCities);
+        }
+        double lookupNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - started).count() / numQueries;
+        size_t pathCities = 0;
+        started = chrono::steady_clock::now();
+        for (int q = 0; q < 10000; q++) {
+            pathCities += table.path(rng() % numCities, rng() % numCities).size();
+        }
+        double pathNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - started).count() / 10000;
+        cout << "Distance lookup: " << lookupNanos << " ns (checksum " << checksum << "), path walk: "
+             << pathNanos << " ns for " << double(pathCities) / 10000 << " cities on average" << endl;
+        return 0;
+    }
+
+#ifndef _WIN32
+    if (name == "shards") {
+        // shards [numCities] [routesPerCity] [numRegions] [numQueries]
+        int numCities = benchmarkOption(args, 1, 20000);
+        int numRegions = benchmarkOption(args, 3, 4);
+        int numQueries = benchmarkOption(args, 4, 200);
+        vector<pair<double, double>> locations;
+        vector<Route> routes = generateRegionalRoutes(numCities, benchmarkOption(args, 2, 3), 42, locations);
+        MonotonicArena arena;
+        RouteGraph original = buildRouteGraph(arena, numCities, routes);
+        // Hilbert numbering makes each region a compact area, so few flights cross regions
+        ReorderedNetwork network = reorderNetwork(original, computeCityOrder(original, CityOrder::Hilbert, locations));
+
+        auto started = chrono::steady_clock::now();
+        ShardedRouter router;
+        if (!router.start(network.graph, numRegions)) {
+            cout << "Could not start shard processes" << endl;
+            return 1;
+        }
+        cout << "Started " << numRegions << " shards in " << chrono::duration<double, milli>(chrono::steady_clock::now() - started).count()
+             << " ms: " << router.numBoundaryCities() << " boundary cities, " << router.numOverlayConnections() << " overlay connections" << endl;
+
+        mt19937 rng(7);
+        int mismatches = 0;
+        double shardMillis = 0, singleMillis = 0;
+        for (int q = 0; q < numQueries; q++) {
+            int from = rng() % numCities;
+            int to = rng() % numCities;
+            started = chrono::steady_clock::now();
+            int sharded;
+            if (!router.distance(from, to, sharded)) {
+                cout << "Shard did not answer query " << q << endl;
+                return 1;
+            }
+            shardMillis += chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+            started = chrono::steady_clock::now();
+            int single = manyToMany(network.graph, vector<int>(1, from), vector<int>(1, to), 1)[0];
+            singleMillis += chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+            mismatches += sharded != single;
+        }
+        cout << "Sharded query: " << shardMillis / numQueries << " ms, single-process search: " << singleMillis / numQueries
+             << " ms, " << mismatches << " of " << numQueries << " distances differ" << endl;
+        return mismatches == 0 ? 0 : 1;
+    }
+#endif
+
+    if (name == "min-hops") {
+        // min-hops [numCities] [routesPerCity] [numOrigins]
+        int numCities = benchmarkOption(args, 1, 200000);
+        int numOrigins = benchmarkOption(args, 3, 256);
+        vector<Route> routes = generateRandomRoutes(numCities, benchmarkOption(args, 2, 3), 42);
+        MonotonicArena arena;
+        RouteGraph graph = buildRouteGraph(arena, numCities, routes);
+        mt19937 rng(7);
+        vector<int> origins(numOrigins);
+        for (int& origin : origins) {
+            origin = rng() % numCities;
+        }
+
+        auto started = chrono::steady_clock::now();
+        HopTable table = minHopBatch(graph, origins, false);
+        double batchMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+
+        // Today's alternative: one search per origin, with every flight counted as one
+        for (auto& route : routes) {
+            route.duration = 1;
+        }
+        MonotonicArena unitArena;
+        RouteGraph unitGraph = buildRouteGraph(unitArena, numCities, routes);
+        int numSearches = min(numOrigins, 16);
+        int mismatches = 0;
+        started = chrono::steady_clock::now();
+        for (int o = 0; o < numSearches; o++) {
+            vector<int> distance = deltaStepping(unitGraph, origins[o], DistanceOnly(), 1);
+            for (int city = 0; city < numCities; city++) {
+                mismatches += (distance[city] == INT_MAX ? -1 : distance[city]) != table.hopCount(o, city);
+            }
+        }
+        double searchMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count() / numSearches;
+
+        cout << "Bit-parallel BFS: " << batchMillis / numOrigins << " ms per origin (" << numOrigins << " origins), "
+             << "one search per origin: " << searchMillis << " ms, " << mismatches << " hop counts differ" << endl;
+        return mismatches == 0 ? 0 : 1;
+    }
+
+    if (name == "oracle") {
+        // oracle [numCities] [routesPerCity] [numLandmarks] [numSamples] [numOrigins]
+        int numCities = benchmarkOption(args, 1, 200000);
+        MonotonicArena arena;
+        RouteGraph graph = buildRouteGraph(arena, numCities, generateRandomRoutes(numCities, benchmarkOption(args, 2, 3), 42));
+        auto started = chrono::steady_clock::now();
+        LandmarkOracle oracle;
+        if (!oracle.build(graph, benchmarkOption(args, 3, 16))) {
+            cout << "The landmark oracle needs a network without one-way flights" << endl;
+            return 1;
+        }
+        cout << "Built oracle in " << chrono::duration<double>(chrono::steady_clock::now() - started).count() << " s" << endl;
+        reportLandmarkOracle(graph, oracle, benchmarkOption(args, 5, 20), benchmarkOption(args, 4, 2000), 7);
+        return 0;
+    }
+
+    if (name == "loadgen") {
+        // loadgen [numCities] [routesPerCity] [targetQps] [numThreads] [numQueries] [traceFile]
+        int numCities = benchmarkOption(args, 1, 10000);
+        int routesPerCity = benchmarkOption(args, 2, 3);
+        int targetQps = benchmarkOption(args, 3, 50000);
+        int numThreads = max(1, benchmarkOption(args, 4, defaultThreadCount()));
+        int numQueries = benchmarkOption(args, 5, 200000);
+        string traceFile = args.size() > 6 ? args[6] : "query_trace.txt";
+
+        // Replay a recorded trace when there is one, otherwise synthesize and record it
+        vector<TraceQuery> trace = loadTrace(traceFile, numCities);
+        if (trace.empty()) {
+            trace = generateTrace(numCities, numQueries, 1.0, 7);
+            saveTrace(trace, traceFile);
+            cout << "Recorded " << trace.size() << " synthesized queries in " << traceFile << endl;
+        } else {
+            cout << "Replaying " << trace.size() << " queries from " << traceFile << endl;
+        }
+
+        SnapshotStore store;
+        store.publish(buildSnapshot(generateAirportCatalog(numCities), generateRandomRoutes(numCities, routesPerCity, 0), true));
+
+        long long numGrounded = 0, checksum = 0;
+        auto started = chrono::steady_clock::now();
+        LatencyHistogram latency = replayTrace(store, trace, targetQps, numThreads, numGrounded, checksum);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+        cout << latency.count() << " queries (" << numGrounded << " grounded by weather or fuel) from " << numThreads
+             << " threads in " << seconds << " s: " << latency.count() / seconds << " queries/s (target "
+             << (targetQps > 0 ? to_string(targetQps) : string("unlimited")) << ", checksum " << checksum << ")" << endl;
+        cout << "Latency us: p50 " << latency.percentile(0.5) / 1000.0 << ", p90 " << latency.percentile(0.9) / 1000.0
+             << ", p99 " << latency.percentile(0.99) / 1000.0 << ", p99.9 " << latency.percentile(0.999) / 1000.0
+             << ", max " << latency.maximum() / 1000.0 << endl;
+        return 0;
+    }
+
+    if (name == "route-policies") {
+        // route-policies [numCities] [routesPerCity] [numQueries] [maxLegMinutes]
+        int numCities = benchmarkOption(args, 1, 100000);
+        int numQueries = benchmarkOption(args, 3, 200);
+        MonotonicArena arena;
+        RouteGraph graph = buildRouteGraph(arena, numCities, generateRandomRoutes(numCities, benchmarkOption(args, 2, 3), 42));
+        LandmarkOracle oracle;
+        if (!oracle.build(graph, 16)) {
+            cout << "The landmark oracle needs a network without one-way flights" << endl;
+            return 1;
+        }
+        MaxLegDuration legLimit = {benchmarkOption(args, 4, 600)};
+
+        mt19937 rng(7);
+        vector<pair<int, int>> pairs(numQueries);
+        for (auto& query : pairs) {
+            query = make_pair(int(rng() % numCities), int(rng() % numCities));
+        }
+        vector<int> prev(numCities, -1);
+        auto timeQueries = [&](const string& label, const function<int(int, int)>& query) {
+            long long checksum = 0;
+            auto started = chrono::steady_clock::now();
+            for (const auto& pair : pairs) {
+                int distance = query(pair.first, pair.second);
+                checksum += distance == INT_MAX ? 0 : distance;
+            }
+            cout << label << ": " << chrono::duration<double, micro>(chrono::steady_clock::now() - started).count() / numQueries
+                 << " us per query (checksum " << checksum << ")" << endl;
+        };
+        timeQueries("shortestRoute, predecessors", [&](int from, int to) {
+            return shortestRoute(graph, from, to, TrackPredecessors{prev}, NoGoal(), Unconstrained());
+        });
+        timeQueries("shortestRoute, distance only", [&](int from, int to) {
+            return shortestRoute(graph, from, to, DistanceOnly(), NoGoal(), Unconstrained());
+        });
+        timeQueries("shortestRoute, landmark goal", [&](int from, int to) {
+            return shortestRoute(graph, from, to, DistanceOnly(), LandmarkGoal{oracle}, Unconstrained());
+        });
+        timeQueries("shortestRoute, landmark goal + predecessors", [&](int from, int to) {
+            return shortestRoute(graph, from, to, TrackPredecessors{prev}, LandmarkGoal{oracle}, Unconstrained());
+        });
+        timeQueries("shortestRoute, legs <= " + to_string(legLimit.limit) + " min", [&](int from, int to) {
+            return shortestRoute(graph, from, to, DistanceOnly(), NoGoal(), legLimit);
+        });
+        timeQueries("deltaStepping, predecessors", [&](int from, int to) {
+            return deltaStepping(graph, from, prev, 1)[to];
+        });
+        timeQueries("deltaStepping, distance only", [&](int from, int to) {
+            return deltaStepping(graph, from, DistanceOnly(), 1)[to];
+        });
+        return 0;
+    }
+
+    cout << "Unknown benchmark: " << name << endl;
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    // FINAL --bench <name> [options] runs a benchmark instead of the interactive planner
+    if (argc > 2 && string(argv[1]) == "--bench") {
+        return runBenchmark(vector<string>(argv + 2, argv + argc));
+    }
+
     srand(time(0)); // Seed the random number generator
 
     int numCities;
     cout << "Enter the number of cities(<30):";
     cin >> numCities;
 
-    vector<City> cities(numCities);
+    AirportCatalog airports;
 
     // Initialize city names
     for (int i = 0; i < numCities; i++) {
-        cities[i].name = generateRandomAirportName();
+        airports.addAirport(generateRandomAirportName());
     }
 
     // Initialize city connections and flight durations with random values
+    vector<Route> routes;
+    routes.reserve(size_t(numCities) * (numCities - 1) / 2);
     for (int i = 0; i < numCities; i++) {
         for (int j = i + 1; j < numCities; j++) {
             int duration = rand() % 990 + 10; // Random flight duration between 10 and 999 minutes
-            cities[i].connections.push_back(make_pair(j, duration));
-            cities[j].connections.push_back(make_pair(i, duration));
+            routes.push_back(Route{i, j, duration});
         }
     }
+    MonotonicArena arena;
+    RouteGraph graph = buildRouteGraph(arena, numCities, routes);
 
     // Print city connections and flight durations
     cout << "City Connections:" << endl;
     for (int i = 0; i < numCities; i++) {
-        cout << "Connections from " << cities[i].name << ":" << endl;
-        for (const auto& connection : cities[i].connections) {
+        cout << "Connections from " << airports.name(i) << ":" << endl;
+        for (const auto& connection : graph.connections(i)) {
             int cityIndex = connection.first;
             int duration = connection.second;
-            cout << cities[cityIndex].name << " (Travel Time: " << duration << " min)" << endl;
+            cout << airports.names.view(generateRandomFlightName(airports, cityIndex)) << " (Travel Time: " << duration << " min)" << endl;
         }
         cout << endl;
     }
 
     int start, end;
-    cout << "Origin Point (1-" << numCities << "): ";
-    cin >> start;
-    cout << "Destination Point (1-" << numCities << "): ";
-    cin >> end;
+    cout << "Origin Point (1-" << numCities << " or IATA code): ";
+    start = readCity(airports);
+    cout << "Destination Point (1-" << numCities << " or IATA code): ";
+    end = readCity(airports);
+    if (start < 1 || start > numCities || end < 1 || end > numCities) {
+        cout << "Unknown airport" << endl;
+        return 1;
+    }
 
     // Get temperature input from the user
     int temperature;
@@ -241,30 +897,31 @@ int main() {
     cin >> fuel;
 
     // Find the shortest path using Dijkstra
+    // Fewer than 30 cities of flights under 1000 minutes: every path fits 16-bit durations
     vector<int> prev(numCities, -1);
-    vector<int> shortestPathDijkstra = dijkstra(cities, start - 1, end - 1, prev);
+    vector<uint16_t> shortestPathDijkstra = dijkstra<uint16_t>(graph, start - 1, end - 1, prev);
 
     // Print the shortest path using Dijkstra
-    cout << "\nShortest path from " << cities[start - 1].name << " to " << cities[end - 1].name <<":";
+    cout << "\nShortest path from " << airports.name(start - 1) << " to " << airports.name(end - 1) <<":";
     cout << "\nDijkstra Algo: ";
-    if (shortestPathDijkstra[end - 1] == INT_MAX) {
+    if (shortestPathDijkstra[end - 1] == numeric_limits<uint16_t>::max()) {
         cout << "No path found";
     } else {
-        printDijkstraPath(cities, start - 1, end - 1, prev);
+        printDijkstraPath(airports, start - 1, end - 1, prev);
         cout << " (" << shortestPathDijkstra[end - 1] << " min)";
     }
 
     // Find the shortest paths using Floyd-Warshall
-    vector<vector<int>> prevFloyd(numCities, vector<int>(numCities, -1));
-    vector<vector<int>> shortestPathsFloydWarshall = floydWarshall(cities, prevFloyd);
+    // 16-bit durations and 8-bit predecessors: 3 bytes per pair instead of 8
+    PathMatrix<uint16_t, uint8_t> shortestPathsFloydWarshall = floydWarshall<uint16_t, uint8_t>(graph);
 
     // Print the shortest path using Floyd-Warshall
     cout << "\nFloyd-Warshall Algo: ";
-    if (shortestPathsFloydWarshall[start - 1][end - 1] == INT_MAX) {
+    if (shortestPathsFloydWarshall.distance(start - 1, end - 1) == shortestPathsFloydWarshall.unreachable) {
         cout << "No path found";
     } else {
-        printFloydWarshallPath(cities, start - 1, end - 1, prevFloyd);
-        cout << " (" << shortestPathsFloydWarshall[start - 1][end - 1] << " min)" << endl;
+        printFloydWarshallPath(airports, start - 1, end - 1, shortestPathsFloydWarshall);
+        cout << " (" << shortestPathsFloydWarshall.distance(start - 1, end - 1) << " min)" << endl;
     }
 
     string weatherStatus = checkWeather(temperature);
@@ -0,0 +1,2983 @@
+// Route solvers shared by the planner (FINAL.cpp) and the self-check (SELFCHECK.cpp)
+#ifndef FINAL_H
+#define FINAL_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <ctime>
+#include <string_view>
+#include <unordered_map>
+#include <random>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <queue>
+#include <thread>
+#include <tuple>
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace std;
+
+// Allocation counters reported by the graph arena and the per-thread query pools
+struct AllocationStats {
+    size_t allocations = 0;    // Buffers handed out
+    size_t bytesRequested = 0; // Bytes asked for by those buffers
+    size_t systemAllocations = 0; // Times memory had to come from the system allocator
+    size_t bytesReserved = 0;  // Bytes obtained from the system allocator
+
+    AllocationStats& operator+=(const AllocationStats& other) {
+        allocations += other.allocations;
+        bytesRequested += other.bytesRequested;
+        systemAllocations += other.systemAllocations;
+        bytesReserved += other.bytesReserved;
+        return *this;
+    }
+    AllocationStats operator-(const AllocationStats& other) const {
+        AllocationStats difference;
+        difference.allocations = allocations - other.allocations;
+        difference.bytesRequested = bytesRequested - other.bytesRequested;
+        difference.systemAllocations = systemAllocations - other.systemAllocations;
+        difference.bytesReserved = bytesReserved - other.bytesReserved;
+        return difference;
+    }
+};
+
+// Monotonic arena: bump allocation out of large blocks, all memory is released together.
+// Only for trivially destructible objects, nothing is ever destroyed individually.
+class MonotonicArena {
+public:
+    explicit MonotonicArena(size_t blockSize = 1 << 20) : blockSize(blockSize) {}
+
+    template <typename T>
+    T* allocate(size_t count) {
+        size_t bytes = count * sizeof(T);
+        size_t padding = (alignof(T) - reinterpret_cast<uintptr_t>(cursor) % alignof(T)) % alignof(T);
+        if (cursor == nullptr || padding + bytes > remaining) {
+            addBlock(max(blockSize, bytes + alignof(T)));
+            padding = (alignof(T) - reinterpret_cast<uintptr_t>(cursor) % alignof(T)) % alignof(T);
+        }
+        T* result = reinterpret_cast<T*>(cursor + padding);
+        cursor += padding + bytes;
+        remaining -= padding + bytes;
+        stats.allocations++;
+        stats.bytesRequested += bytes;
+        return result;
+    }
+
+    // Make sure the next 'bytes' of allocations fit in the current block
+    void reserve(size_t bytes) {
+        if (cursor == nullptr || remaining < bytes) {
+            addBlock(max(blockSize, bytes));
+        }
+    }
+
+    const AllocationStats& allocationStats() const {
+        return stats;
+    }
+
+private:
+    void addBlock(size_t bytes) {
+        blocks.emplace_back(new char[bytes]);
+        cursor = blocks.back().get();
+        remaining = bytes;
+        stats.systemAllocations++;
+        stats.bytesReserved += bytes;
+    }
+
+    size_t blockSize;
+    vector<unique_ptr<char[]>> blocks;
+    char* cursor = nullptr;
+    size_t remaining = 0;
+    AllocationStats stats;
+};
+
+// Routing graph in compressed form: the connections of city u are edges[offsets[u], offsets[u + 1]).
+// The arrays live in a MonotonicArena that must outlive the graph.
+struct RouteGraph {
+    struct Connections {
+        const pair<int, int>* first;
+        const pair<int, int>* last;
+        const pair<int, int>* begin() const { return first; }
+        const pair<int, int>* end() const { return last; }
+        size_t size() const { return last - first; }
+    };
+
+    int numCities = 0;
+    const size_t* offsets = nullptr;
+    const pair<int, int>* edges = nullptr; // pair represents (city_index, flight_duration)
+
+    int size() const {
+        return numCities;
+    }
+    size_t numConnections() const {
+        return numCities == 0 ? 0 : offsets[numCities];
+    }
+    Connections connections(int city) const {
+        return Connections{edges + offsets[city], edges + offsets[city + 1]};
+    }
+};
+
+// A flight between two cities, used as input when building a RouteGraph
+struct Route {
+    int from;
+    int to;
+    int duration;
+};
+
+// Function to build a RouteGraph in the arena. A counting pass sizes every city's
+// connections exactly, so the fill pass never reallocates.
+RouteGraph buildRouteGraph(MonotonicArena& arena, int numCities, const vector<Route>& routes, bool bothDirections = true) {
+    size_t numEdges = routes.size() * (bothDirections ? 2 : 1);
+    arena.reserve((numCities + 1) * sizeof(size_t) + numEdges * sizeof(pair<int, int>) + alignof(pair<int, int>));
+    size_t* offsets = arena.allocate<size_t>(numCities + 1);
+    pair<int, int>* edges = arena.allocate<pair<int, int>>(numEdges);
+
+    // Counting pass: offsets[u + 1] holds the degree of u, then a prefix sum turns it into a start
+    fill(offsets, offsets + numCities + 1, 0);
+    for (const auto& route : routes) {
+        offsets[route.from + 1]++;
+        if (bothDirections) {
+            offsets[route.to + 1]++;
+        }
+    }
+    for (int city = 0; city < numCities; city++) {
+        offsets[city + 1] += offsets[city];
+    }
+
+    // Fill pass, keeping the routes' order within every city
+    vector<size_t> cursor(offsets, offsets + numCities);
+    for (const auto& route : routes) {
+        new (&edges[cursor[route.from]++]) pair<int, int>(route.to, route.duration);
+        if (bothDirections) {
+            new (&edges[cursor[route.to]++]) pair<int, int>(route.from, route.duration);
+        }
+    }
+
+    RouteGraph graph;
+    graph.numCities = numCities;
+    graph.offsets = offsets;
+    graph.edges = edges;
+    return graph;
+}
+
+// Free list of per-query buffers: released buffers keep their capacity for the next query
+template <typename T>
+class BufferPool {
+public:
+    vector<T> acquire(size_t size, const T& value) {
+        // Best fit: the smallest free buffer that already holds size, else the largest one
+        vector<T> buffer;
+        if (!freeList.empty()) {
+            size_t best = 0;
+            for (size_t i = 1; i < freeList.size(); i++) {
+                size_t capacity = freeList[i].capacity();
+                size_t bestCapacity = freeList[best].capacity();
+                if (bestCapacity < size ? capacity > bestCapacity : capacity >= size && capacity < bestCapacity) {
+                    best = i;
+                }
+            }
+            buffer = move(freeList[best]);
+            freeList[best] = move(freeList.back());
+            freeList.pop_back();
+        }
+        if (buffer.capacity() < size) {
+            stats.systemAllocations++;
+            stats.bytesReserved += (size - buffer.capacity()) * sizeof(T);
+        }
+        buffer.assign(size, value);
+        stats.allocations++;
+        stats.bytesRequested += size * sizeof(T);
+        lentCapacities.push_back(buffer.capacity());
+        return buffer;
+    }
+
+    // A buffer that comes back larger than any lent one grew while in use (heaps, path lists)
+    void release(vector<T>&& buffer) {
+        auto lent = find(lentCapacities.begin(), lentCapacities.end(), buffer.capacity());
+        if (lent == lentCapacities.end()) {
+            lent = lentCapacities.begin();
+            for (auto it = lentCapacities.begin(); it != lentCapacities.end(); ++it) {
+                if (*it < buffer.capacity() && (*lent > buffer.capacity() || *it > *lent)) {
+                    lent = it;
+                }
+            }
+            if (lent != lentCapacities.end() && *lent < buffer.capacity()) {
+                stats.systemAllocations++;
+                stats.bytesReserved += (buffer.capacity() - *lent) * sizeof(T);
+            }
+        }
+        if (lent != lentCapacities.end()) {
+            *lent = lentCapacities.back();
+            lentCapacities.pop_back();
+        }
+        freeList.push_back(move(buffer));
+    }
+
+    const AllocationStats& allocationStats() const {
+        return stats;
+    }
+
+private:
+    vector<vector<T>> freeList;
+    vector<size_t> lentCapacities; // Capacity of every buffer handed out and not yet released
+    AllocationStats stats;
+};
+
+// Per-thread pool for query temporaries: distance and label arrays, visited flags, heaps, paths.
+// Every pool registers itself so allThreadsStats() can total the traffic of all threads.
+struct QueryPool {
+    QueryPool() {
+        lock_guard<mutex> lock(registryMutex());
+        livePools().push_back(this);
+    }
+    ~QueryPool() {
+        lock_guard<mutex> lock(registryMutex());
+        exitedThreadsStats() += allocationStats();
+        livePools().erase(find(livePools().begin(), livePools().end(), this));
+    }
+    QueryPool(const QueryPool&) = delete;
+    QueryPool& operator=(const QueryPool&) = delete;
+
+    BufferPool<int> ints;
+    BufferPool<char> flags;
+    BufferPool<pair<int, int>> pairs;
+
+    // Distance array kept all INT_MAX between queries, so searches that touch only a few
+    // cities skip the O(V) fill. Callers must reset every entry they change.
+    vector<int>& cleanDistances(size_t size) {
+        if (cleanDistanceArray.size() < size) {
+            cleanDistanceArray.resize(size, INT_MAX);
+        }
+        return cleanDistanceArray;
+    }
+
+    AllocationStats allocationStats() const {
+        AllocationStats total;
+        for (const AllocationStats* part : {&ints.allocationStats(), &flags.allocationStats(), &pairs.allocationStats()}) {
+            total += *part;
+        }
+        return total;
+    }
+
+    // Totals over the pools of every thread, including threads that have exited.
+    // Other threads' counters are read unsynchronized, so call it while no query runs.
+    static AllocationStats allThreadsStats() {
+        lock_guard<mutex> lock(registryMutex());
+        AllocationStats total = exitedThreadsStats();
+        for (const QueryPool* pool : livePools()) {
+            total += pool->allocationStats();
+        }
+        return total;
+    }
+
+private:
+    static mutex& registryMutex() {
+        static mutex registry;
+        return registry;
+    }
+    static vector<QueryPool*>& livePools() {
+        static vector<QueryPool*> pools;
+        return pools;
+    }
+    static AllocationStats& exitedThreadsStats() {
+        static AllocationStats stats;
+        return stats;
+    }
+
+    vector<int> cleanDistanceArray;
+};
+
+// Function to get the calling thread's query pool
+QueryPool& queryPool() {
+    static thread_local QueryPool pool;
+    return pool;
+}
+
+// Interned string pool: every name is stored once in a single arena and referenced by a 32-bit id
+class NamePool {
+public:
+    uint32_t intern(string_view name) {
+        size_t hash = std::hash<string_view>()(name);
+        auto range = idsByHash.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (view(it->second) == name) {
+                return it->second;
+            }
+        }
+
+        uint32_t id = offsets.size() - 1;
+        arena.append(name.data(), name.size());
+        offsets.push_back(arena.size());
+        idsByHash.emplace(hash, id);
+        return id;
+    }
+
+    string_view view(uint32_t id) const {
+        return string_view(arena.data() + offsets[id], offsets[id + 1] - offsets[id]);
+    }
+
+    size_t size() const {
+        return offsets.size() - 1;
+    }
+
+    size_t arenaBytes() const {
+        return arena.size();
+    }
+
+private:
+    string arena;
+    vector<uint32_t> offsets = {0}; // Name id spans arena[offsets[id], offsets[id + 1])
+    unordered_multimap<size_t, uint32_t> idsByHash;
+};
+
+// Function to pack a three-letter IATA code into one integer, returns 0 if it is not a code
+constexpr uint32_t packAirportCode(string_view code) {
+    if (code.size() != 3) {
+        return 0;
+    }
+    uint32_t packed = 0;
+    for (char letter : code) {
+        if (letter < 'A' || letter > 'Z') {
+            return 0;
+        }
+        packed = packed * 32 + (letter - 'A' + 1);
+    }
+    return packed;
+}
+
+// Built-in airport: display name, IATA code and location (latitude, longitude)
+struct BuiltinAirport {
+    string_view name;
+    string_view code;
+    double latitude;
+    double longitude;
+};
+
+// The built-in airport catalog, fixed at compile time
+constexpr BuiltinAirport builtinAirports[] = {
+    {"Visakhapatnam (VTZ)", "VTZ", 17.72, 83.22},
+    {"Vijayawada (VGA)", "VGA", 16.53, 80.80},
+    {"Guwahati (GAU)", "GAU", 26.11, 91.59},
+    {"Muzaffarpur (MZU)", "MZU", 26.12, 85.31},
+    {"Bilaspur (PAB)", "PAB", 21.99, 82.11},
+    {"Raipur (RPR)", "RPR", 21.18, 81.74},
+    {"Ahmedabad (AMD)", "AMD", 23.07, 72.63},
+    {"Rajkot (HSR)", "HSR", 22.38, 71.03},
+    {"Kullu-Manali (KUU)", "KUU", 31.88, 77.15},
+    {"Shimla (SLV)", "SLV", 31.08, 77.07},
+    {"Ranchi (IXR)", "IXR", 23.31, 85.32},
+    {"Bengaluru (BLR)", "BLR", 13.20, 77.71},
+    {"Mangaluru (IXE)", "IXE", 12.96, 74.89},
+    {"Kochi (COK)", "COK", 10.15, 76.40},
+    {"Thiruvananthapuram (TRV)", "TRV", 8.48, 76.92},
+    {"Bhopal (BHO)", "BHO", 23.29, 77.34},
+    {"Mumbai (BOM)", "BOM", 19.09, 72.87},
+    {"Nagpur (NAG)", "NAG", 21.09, 79.05},
+    {"Shirdi (SAG)", "SAG", 19.69, 74.38},
+    {"Imphal (IMF)", "IMF", 24.76, 93.90},
+    {"Shillong (SHL)", "SHL", 25.70, 91.98},
+    {"Bhuvaneshwar (BBI)", "BBI", 20.24, 85.82},
+    {"Amritsar (ATQ)", "ATQ", 31.71, 74.80},
+    {"Jaipur (JAI)", "JAI", 26.82, 75.81},
+    {"Chennai (MAA)", "MAA", 12.99, 80.17},
+    {"Coimbatore (CJB)", "CJB", 11.03, 77.04},
+    {"Hyderabad (HYD)", "HYD", 17.24, 78.43},
+    {"Delhi-NCR (DEL)", "DEL", 28.56, 77.10},
+    {"Kolkata (CCU)", "CCU", 22.65, 88.45},
+    {"Srinagar (SXR)", "SXR", 33.99, 74.77}
+};
+constexpr int numBuiltinAirports = sizeof(builtinAirports) / sizeof(builtinAirports[0]);
+
+// Function to check at compile time that every name ends in its own "(CODE)" and codes are unique
+constexpr bool builtinAirportsConsistent() {
+    for (int i = 0; i < numBuiltinAirports; i++) {
+        string_view name = builtinAirports[i].name;
+        if (packAirportCode(builtinAirports[i].code) == 0 || name.size() < 6 || name[name.size() - 5] != '('
+            || name.substr(name.size() - 4, 3) != builtinAirports[i].code || name.back() != ')') {
+            return false;
+        }
+        for (int j = 0; j < i; j++) {
+            if (builtinAirports[j].code == builtinAirports[i].code) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+static_assert(builtinAirportsConsistent(), "built-in airport names must end in their unique IATA code");
+
+// Function to look up the location (latitude, longitude) of a built-in airport by packed IATA code
+bool findAirportLocation(uint32_t code, pair<double, double>& location) {
+    for (const auto& airport : builtinAirports) {
+        if (packAirportCode(airport.code) == code) {
+            location = make_pair(airport.latitude, airport.longitude);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Cold airport metadata, kept apart from the RouteGraph routing arrays
+struct AirportCatalog {
+    NamePool names;
+    vector<uint32_t> nameIds;                // nameIds[city] is the interned airport name
+    unordered_map<uint32_t, int> cityByCode; // packed IATA code -> city index
+    vector<pair<double, double>> locations;  // (latitude, longitude) per city, (0, 0) if unknown
+
+    // Register the next city's airport name, e.g. "Kochi (COK)", and index its code
+    int addAirport(string_view name) {
+        int city = nameIds.size();
+        nameIds.push_back(names.intern(name));
+        locations.push_back(make_pair(0.0, 0.0));
+        size_t open = name.rfind('(');
+        size_t close = name.rfind(')');
+        if (open != string_view::npos && close == open + 4) {
+            uint32_t code = packAirportCode(name.substr(open + 1, 3));
+            if (code != 0) {
+                cityByCode.emplace(code, city);
+                findAirportLocation(code, locations[city]);
+            }
+        }
+        return city;
+    }
+
+    // Renumbered copy of the catalog: city order[i] here becomes city i in the copy
+    AirportCatalog reordered(const vector<int>& order) const {
+        AirportCatalog copy;
+        copy.names = names;
+        vector<int> newIndex(order.size());
+        for (int newCity = 0; newCity < int(order.size()); newCity++) {
+            copy.nameIds.push_back(nameIds[order[newCity]]);
+            copy.locations.push_back(locations[order[newCity]]);
+            newIndex[order[newCity]] = newCity;
+        }
+        for (const auto& entry : cityByCode) {
+            copy.cityByCode.emplace(entry.first, newIndex[entry.second]);
+        }
+        return copy;
+    }
+
+    string_view name(int city) const {
+        return names.view(nameIds[city]);
+    }
+
+    int size() const {
+        return nameIds.size();
+    }
+
+    // Returns the city index for an IATA code such as "HYD", or -1 if unknown
+    int findByCode(string_view code) const {
+        auto it = cityByCode.find(packAirportCode(code));
+        return it == cityByCode.end() ? -1 : it->second;
+    }
+};
+
+// Function to generate a random airport name from the built-in catalog, never the same one twice
+string_view generateRandomAirportName() {
+    static bool usedIndices[numBuiltinAirports] = {false}; // Track used indices
+
+    int randomIndex;
+    do {
+        randomIndex = rand() % numBuiltinAirports;
+    } while (usedIndices[randomIndex]); // Ensure it's not a used index
+
+    usedIndices[randomIndex] = true;
+    return builtinAirports[randomIndex].name;
+}
+// Function to generate a random flight name to a catalog city, interned into the catalog's pool
+uint32_t generateRandomFlightName(AirportCatalog& airports, int destination) {
+    static const string airlines[] = {
+        "Delta Air Lines",
+        "American Airlines",
+        "United Airlines",
+        "Southwest Airlines",
+        "Emirates",
+        "Air China",
+        "British Airways",
+        "Japan Airlines",
+        "Qantas",
+        "Lufthansa"
+    };
+
+    int numAirlines = sizeof(airlines) / sizeof(airlines[0]);
+    int randomAirlineIndex = rand() % numAirlines;
+
+    static thread_local string flightName; // Reused so composing a name does not allocate
+    flightName = airlines[randomAirlineIndex];
+    flightName += " Flight to ";
+    flightName += airports.name(destination);
+
+    return airports.names.intern(flightName);
+}
+
+// Function to name the cities of a generated network: the built-in airports first, in catalog
+// order, then numbered airports without an IATA code
+AirportCatalog generateAirportCatalog(int numCities) {
+    AirportCatalog airports;
+    for (int city = 0; city < numCities; city++) {
+        if (city < numBuiltinAirports) {
+            airports.addAirport(builtinAirports[city].name);
+        } else {
+            airports.addAirport("Airport " + to_string(city + 1));
+        }
+    }
+    return airports;
+}
+
+// Function to add two non-negative durations, clamping at the "no path" sentinel instead of overflowing
+template <typename Weight>
+Weight saturatingAdd(Weight a, Weight b) {
+    const Weight limit = numeric_limits<Weight>::max();
+    return a >= limit - b ? limit : Weight(a + b);
+}
+
+// Function to narrow a duration to Weight, clamping at the "no path" sentinel
+template <typename Weight>
+Weight clampDuration(long long duration) {
+    return Weight(min<long long>(duration, numeric_limits<Weight>::max()));
+}
+
+// Path policies for the solvers: TrackPredecessors writes each city's predecessor into prev,
+// DistanceOnly compiles those writes out for queries that only need durations
+struct TrackPredecessors {
+    static constexpr bool enabled = true;
+    vector<int>& prev;
+    void record(int city, int predecessor) const {
+        prev[city] = predecessor;
+    }
+};
+struct DistanceOnly {
+    static constexpr bool enabled = false;
+    void record(int, int) const {}
+};
+
+// Function to find the shortest path between two cities using Dijkstra's algorithm.
+// Durations are Weight wide; numeric_limits<Weight>::max() means no path (or one that long).
+template <typename Weight = int, typename Paths>
+vector<Weight> dijkstra(const RouteGraph& graph, int start, int end, const Paths& paths) {
+    const Weight unreachable = numeric_limits<Weight>::max();
+    int numCities = graph.size();
+    vector<Weight> distance(numCities, unreachable); // Initialize distances to infinity
+    vector<char> visited = queryPool().flags.acquire(numCities, false); // Initialize visited array
+
+    distance[start] = 0; // Distance from start city to itself is 0
+
+    for (int i = 0; i < numCities - 1; i++) {
+        Weight minDistance = unreachable;
+        int minIndex = -1;
+
+        // Find the city with the minimum distance
+        for (int j = 0; j < numCities; j++) {
+            if (!visited[j] && distance[j] <= minDistance) {
+                minDistance = distance[j];
+                minIndex = j;
+            }
+        }
+        if (minDistance == unreachable) {
+            break; // The remaining cities are unreachable
+        }
+
+        visited[minIndex] = true; // Mark the city as visited
+
+        // Update the distances of the neighboring cities
+        for (const auto& connection : graph.connections(minIndex)) {
+            int neighbor = connection.first;
+            Weight duration = clampDuration<Weight>(connection.second);
+            if (!visited[neighbor] && saturatingAdd(distance[minIndex], duration) < distance[neighbor]) {
+                distance[neighbor] = saturatingAdd(distance[minIndex], duration);
+                if constexpr (Paths::enabled) {
+                    paths.record(neighbor, minIndex);
+                }
+            }
+        }
+    }
+
+    queryPool().flags.release(move(visited));
+    return distance;
+}
+
+template <typename Weight = int>
+vector<Weight> dijkstra(const RouteGraph& graph, int start, int end, vector<int>& prev) {
+    return dijkstra<Weight>(graph, start, end, TrackPredecessors{prev});
+}
+
+// Function to get the number of worker threads to use when none is requested
+int defaultThreadCount() {
+    unsigned hardwareThreads = thread::hardware_concurrency();
+    return hardwareThreads == 0 ? 1 : static_cast<int>(hardwareThreads);
+}
+
+// Worker threads shared by every parallelFor call. They are started on first use and kept, so
+// a parallel phase costs a wake-up instead of creating and joining threads, and every worker
+// keeps its thread_local QueryPool between calls.
+class WorkerPool {
+public:
+    static WorkerPool& shared() {
+        static WorkerPool* pool = new WorkerPool(); // Never destroyed: idle workers are still waiting at exit
+        return *pool;
+    }
+
+    // Run task(0) .. task(numTasks - 1) on up to numThreads threads, the caller included, and
+    // return when all are done. A call made from inside a task, or while another thread is using
+    // the pool, runs its tasks on the calling thread instead of waiting.
+    void run(int numTasks, int numThreads, const function<void(int)>& task) {
+        unique_lock<mutex> busy(runMutex, defer_lock);
+        if (numThreads <= 1 || runningTask || !busy.try_lock()) {
+            for (int t = 0; t < numTasks; t++) {
+                task(t);
+            }
+            return;
+        }
+
+        {
+            lock_guard<mutex> lock(stateMutex);
+            while (int(workers.size()) < min(numThreads, numTasks) - 1) {
+                workers.emplace_back([this]() { workerLoop(); });
+            }
+            currentTask = &task;
+            taskCount = numTasks;
+            finishedTasks = 0;
+            nextTask.store(0, memory_order_relaxed);
+            generation++;
+        }
+        wakeWorkers.notify_all();
+
+        int done = runTasks(task, numTasks);
+        unique_lock<mutex> lock(stateMutex);
+        finishedTasks += done;
+        // Workers that joined this generation must leave before the task goes out of scope
+        allDone.wait(lock, [this]() { return finishedTasks == taskCount && activeWorkers == 0; });
+        currentTask = nullptr;
+    }
+
+    // Join every worker thread, waiting for a run in progress first. The next run starts new
+    // ones. Returns false, without waiting, when called from inside a task.
+    bool retireWorkers() {
+        if (runningTask) {
+            return false;
+        }
+        lock_guard<mutex> busy(runMutex);
+        {
+            lock_guard<mutex> lock(stateMutex);
+            retiring = true;
+        }
+        wakeWorkers.notify_all();
+        for (thread& worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+        retiring = false;
+        return true;
+    }
+
+private:
+    WorkerPool() = default;
+
+    int runTasks(const function<void(int)>& task, int numTasks) {
+        runningTask = true;
+        int done = 0;
+        for (int t = nextTask.fetch_add(1); t < numTasks; t = nextTask.fetch_add(1)) {
+            task(t);
+            done++;
+        }
+        runningTask = false;
+        return done;
+    }
+
+    void workerLoop() {
+        uint64_t seen = 0;
+        unique_lock<mutex> lock(stateMutex);
+        while (true) {
+            wakeWorkers.wait(lock, [&]() { return retiring || (generation != seen && currentTask != nullptr); });
+            if (retiring) {
+                return;
+            }
+            seen = generation;
+            const function<void(int)>* task = currentTask;
+            int numTasks = taskCount;
+            activeWorkers++;
+            lock.unlock();
+            int done = runTasks(*task, numTasks);
+            lock.lock();
+            finishedTasks += done;
+            activeWorkers--;
+            allDone.notify_all();
+        }
+    }
+
+    static thread_local bool runningTask;
+    mutex runMutex;   // Held by the caller of run() for the whole call
+    mutex stateMutex; // Guards everything below except nextTask
+    condition_variable wakeWorkers, allDone;
+    vector<thread> workers;
+    const function<void(int)>* currentTask = nullptr;
+    int taskCount = 0;
+    int finishedTasks = 0;
+    int activeWorkers = 0;
+    uint64_t generation = 0;
+    bool retiring = false;
+    atomic<int> nextTask{0};
+};
+thread_local bool WorkerPool::runningTask = false;
+
+// Function to run body(begin, end, chunk) over [0, count) split into chunks for the worker
+// pool. Each chunk runs on one thread at a time, so per-chunk buffers need no locking.
+template <typename Body>
+void parallelFor(size_t count, int numThreads, size_t minPerThread, Body body) {
+    size_t usefulThreads = max<size_t>(1, count / max<size_t>(1, minPerThread));
+    size_t threadsToUse = min<size_t>(max(1, numThreads), usefulThreads);
+    if (threadsToUse <= 1) {
+        body(size_t(0), count, 0);
+        return;
+    }
+
+    size_t chunk = (count + threadsToUse - 1) / threadsToUse;
+    int numChunks = (count + chunk - 1) / chunk;
+    WorkerPool::shared().run(numChunks, threadsToUse, [&](int t) {
+        body(t * chunk, min(count, (t + 1) * chunk), t);
+    });
+}
+
+// Function to lower an atomic distance to candidate, returns true if it improved
+template <typename Weight>
+bool atomicMin(atomic<Weight>& target, Weight candidate) {
+    Weight current = target.load(memory_order_relaxed);
+    while (candidate < current) {
+        if (target.compare_exchange_weak(current, candidate, memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Function to pick the delta-stepping bucket width from the flight durations
+int autoTuneDelta(const RouteGraph& graph) {
+    size_t numConnections = graph.numConnections();
+    int minDuration = INT_MAX;
+    int maxDuration = 1;
+    for (size_t e = 0; e < numConnections; e++) {
+        minDuration = min(minDuration, graph.edges[e].second);
+        maxDuration = max(maxDuration, graph.edges[e].second);
+    }
+    if (numConnections == 0) {
+        return 1;
+    }
+
+    // Max duration over average degree keeps buckets small on dense networks,
+    // but a bucket narrower than the shortest flight only adds empty phases
+    double averageDegree = double(numConnections) / graph.size();
+    int delta = static_cast<int>(maxDuration / max(1.0, averageDegree));
+    return max(max(delta, minDuration), 1);
+}
+
+// Function to find the shortest paths from one city to all others using parallel delta-stepping.
+// Distances and prev match dijkstra exactly (flight durations must be positive).
+template <typename Weight = int, typename Paths>
+vector<Weight> deltaStepping(const RouteGraph& graph, int start, const Paths& paths, int numThreads = 0) {
+    static_assert(sizeof(Weight) <= 4, "predecessor keys pack a duration into 32 bits");
+    const Weight unreachable = numeric_limits<Weight>::max();
+    int numCities = graph.size();
+    if (numThreads <= 0) {
+        numThreads = defaultThreadCount();
+    }
+    const size_t minPerThread = 256; // Smaller frontiers are cheaper to relax on one thread
+
+    int delta = autoTuneDelta(graph);
+    int maxDuration = 1;
+    for (size_t e = 0; e < graph.numConnections(); e++) {
+        maxDuration = max(maxDuration, graph.edges[e].second);
+    }
+
+    vector<atomic<Weight>> distance(numCities);
+    for (auto& d : distance) {
+        d.store(unreachable, memory_order_relaxed);
+    }
+    distance[start].store(0, memory_order_relaxed);
+
+    // Pending cities are never more than maxDuration past the current bucket,
+    // so a ring of buckets covers them all. Every worker fills its own ring; a city
+    // can sit in several buckets, and only the one matching its distance counts.
+    size_t numBuckets = maxDuration / delta + 2;
+    vector<vector<vector<int>>> buckets(numThreads, vector<vector<int>>(numBuckets));
+    buckets[0][0].push_back(start);
+    auto bucketEmpty = [&](size_t b) {
+        for (const auto& ring : buckets) {
+            if (!ring[b].empty()) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    vector<int> frontierStamp(numCities, -1); // Last phase a city joined the frontier
+    vector<long long> settledBucket(numCities, -1); // Bucket a city was settled in
+    int phase = 0;
+
+    // Relax the light (<= delta) or heavy (> delta) connections of every city in the list
+    auto relax = [&](const vector<int>& list, bool light) {
+        parallelFor(list.size(), numThreads, minPerThread, [&](size_t begin, size_t end, int worker) {
+            vector<vector<int>>& ring = buckets[worker];
+            for (size_t k = begin; k < end; k++) {
+                int u = list[k];
+                Weight du = distance[u].load(memory_order_relaxed);
+                for (const auto& connection : graph.connections(u)) {
+                    if ((connection.second <= delta) != light) {
+                        continue;
+                    }
+                    Weight candidate = saturatingAdd(du, clampDuration<Weight>(connection.second));
+                    if (atomicMin(distance[connection.first], candidate)) {
+                        ring[(candidate / delta) % numBuckets].push_back(connection.first);
+                    }
+                }
+            }
+        });
+    };
+
+    long long current = 0;
+    size_t emptyInARow = 0;
+    vector<int> frontier, settled;
+    while (emptyInARow < numBuckets) {
+        size_t b = current % numBuckets;
+        if (bucketEmpty(b)) {
+            emptyInARow++;
+            current++;
+            continue;
+        }
+        emptyInARow = 0;
+
+        // Light edges can refill the current bucket, so repeat until it stays empty
+        settled.clear();
+        while (!bucketEmpty(b)) {
+            frontier.clear();
+            phase++;
+            for (auto& ring : buckets) {
+                for (int v : ring[b]) {
+                    if (distance[v].load(memory_order_relaxed) / delta == current && frontierStamp[v] != phase) {
+                        frontierStamp[v] = phase;
+                        frontier.push_back(v);
+                        if (settledBucket[v] != current) {
+                            settledBucket[v] = current;
+                            settled.push_back(v);
+                        }
+                    }
+                }
+                ring[b].clear();
+            }
+            relax(frontier, true);
+        }
+        relax(settled, false);
+        current++;
+    }
+
+    vector<Weight> result(numCities);
+    for (int v = 0; v < numCities; v++) {
+        result[v] = distance[v].load(memory_order_relaxed);
+    }
+    if constexpr (!Paths::enabled) {
+        return result;
+    }
+
+    // Rebuild prev the way dijkstra would: the predecessor it settles first
+    // (smallest distance, then highest index) among all tight connections
+    atomic<bool> zeroFlights(false);
+    vector<atomic<unsigned long long>> bestPredecessor(numCities);
+    for (auto& key : bestPredecessor) {
+        key.store(ULLONG_MAX, memory_order_relaxed);
+    }
+    parallelFor(numCities, numThreads, minPerThread, [&](size_t begin, size_t end, int) {
+        for (size_t u = begin; u < end; u++) {
+            Weight du = result[u];
+            if (du == unreachable) {
+                continue;
+            }
+            unsigned long long key = (static_cast<unsigned long long>(du) << 32) | (0xFFFFFFFFu - static_cast<unsigned>(u));
+            for (const auto& connection : graph.connections(u)) {
+                int v = connection.first;
+                Weight dv = result[v];
+                if (v == start || dv == unreachable || saturatingAdd(du, clampDuration<Weight>(connection.second)) != dv) {
+                    continue;
+                }
+                if (connection.second == 0) {
+                    zeroFlights.store(true, memory_order_relaxed);
+                    continue;
+                }
+                unsigned long long best = bestPredecessor[v].load(memory_order_relaxed);
+                while (key < best && !bestPredecessor[v].compare_exchange_weak(best, key, memory_order_relaxed)) {
+                }
+            }
+        }
+    });
+
+    // A flight that takes no time joins two cities at the same distance, where that order could
+    // close a cycle: hang the cities only reached that way off the tree breadth-first instead
+    if (zeroFlights.load(memory_order_relaxed)) {
+        vector<int> queue;
+        for (int v = 0; v < numCities; v++) {
+            if (v == start || bestPredecessor[v].load(memory_order_relaxed) != ULLONG_MAX) {
+                queue.push_back(v);
+            }
+        }
+        for (size_t head = 0; head < queue.size(); head++) {
+            int u = queue[head];
+            for (const auto& connection : graph.connections(u)) {
+                int v = connection.first;
+                if (connection.second == 0 && v != start && result[v] == result[u] && bestPredecessor[v].load(memory_order_relaxed) == ULLONG_MAX) {
+                    bestPredecessor[v].store((static_cast<unsigned long long>(result[u]) << 32) | (0xFFFFFFFFu - static_cast<unsigned>(u)), memory_order_relaxed);
+                    queue.push_back(v);
+                }
+            }
+        }
+    }
+
+    for (int v = 0; v < numCities; v++) {
+        unsigned long long key = bestPredecessor[v].load(memory_order_relaxed);
+        if (key != ULLONG_MAX) {
+            paths.record(v, static_cast<int>(0xFFFFFFFFu - static_cast<unsigned>(key & 0xFFFFFFFFu)));
+        }
+    }
+    return result;
+}
+
+template <typename Weight = int>
+vector<Weight> deltaStepping(const RouteGraph& graph, int start, vector<int>& prev, int numThreads = 0) {
+    return deltaStepping<Weight>(graph, start, TrackPredecessors{prev}, numThreads);
+}
+
+// What a heap search does with a city it has just settled: relax its flights, leave them
+// (the city is settled but the search does not go on through it), or end the search
+enum class SearchStep { Expand, Prune, Stop };
+
+// Defaults for the policies heapSearch runs with. A policy overrides what its query needs;
+// the flags keep unused goal and constraint code out of the relaxation loop.
+struct SearchDefaults {
+    static constexpr bool goalDirected = false; // Heap key adds lowerBound(city)
+    static constexpr bool constrained = false;  // Only flights allows() accepts are taken
+    int lowerBound(int) const {
+        return 0;
+    }
+    bool allows(int) const {
+        return true;
+    }
+    int limit() const {
+        return INT_MAX; // Arrivals later than this are dropped
+    }
+    void reached(int, int) {} // City got a shorter duration through predecessor
+    SearchStep settle(int, int) {
+        return SearchStep::Expand;
+    }
+};
+
+// Function to run the heap-based Dijkstra search the point-to-point, bounded and batch queries
+// share, from seeds given as (city, duration). Durations live in the thread's clean distance
+// array and are reset before returning, so results reach the caller through the policy.
+template <typename Search>
+void heapSearch(const RouteGraph& graph, const pair<int, int>* seeds, size_t numSeeds, Search& search) {
+    QueryPool& pool = queryPool();
+    vector<int>& distance = pool.cleanDistances(graph.size());
+    vector<int> touched = pool.ints.acquire(0, 0);
+    vector<pair<int, int>> heap = pool.pairs.acquire(0, make_pair(0, 0)); // Min-heap of (key, city)
+    auto key = [&](int city) {
+        if constexpr (Search::goalDirected) {
+            return saturatingAdd(distance[city], search.lowerBound(city));
+        } else {
+            return distance[city];
+        }
+    };
+
+    for (size_t i = 0; i < numSeeds; i++) {
+        int city = seeds[i].first;
+        if (seeds[i].second < distance[city]) {
+            if (distance[city] == INT_MAX) {
+                touched.push_back(city);
+            }
+            distance[city] = seeds[i].second;
+            heap.push_back(make_pair(key(city), city));
+        }
+    }
+    make_heap(heap.begin(), heap.end(), greater<pair<int, int>>());
+
+    while (!heap.empty()) {
+        pop_heap(heap.begin(), heap.end(), greater<pair<int, int>>());
+        int k = heap.back().first;
+        int u = heap.back().second;
+        heap.pop_back();
+        if (k > key(u)) {
+            continue; // Stale entry, u was already settled closer
+        }
+        SearchStep step = search.settle(u, distance[u]);
+        if (step == SearchStep::Stop) {
+            break;
+        }
+        if (step == SearchStep::Prune) {
+            continue;
+        }
+
+        for (const auto& connection : graph.connections(u)) {
+            if constexpr (Search::constrained) {
+                if (!search.allows(connection.second)) {
+                    continue;
+                }
+            }
+            int neighbor = connection.first;
+            int candidate = saturatingAdd(distance[u], connection.second);
+            if (candidate < distance[neighbor] && candidate <= search.limit()) {
+                if (distance[neighbor] == INT_MAX) {
+                    touched.push_back(neighbor);
+                }
+                distance[neighbor] = candidate;
+                search.reached(neighbor, u);
+                heap.push_back(make_pair(key(neighbor), neighbor));
+                push_heap(heap.begin(), heap.end(), greater<pair<int, int>>());
+            }
+        }
+    }
+
+    for (int city : touched) {
+        distance[city] = INT_MAX;
+    }
+    pool.ints.release(move(touched));
+    pool.pairs.release(move(heap));
+}
+
+// Search policy for one manyToMany row: fill the columns of each destination as it is
+// settled, and stop once every destination is
+template <typename Weight>
+struct TableRowSearch : SearchDefaults {
+    const vector<int>& firstColumn;
+    const vector<int>& nextColumn;
+    Weight* row;
+    int remaining;
+
+    SearchStep settle(int city, int distance) {
+        if (firstColumn[city] == -1) {
+            return SearchStep::Expand;
+        }
+        for (int column = firstColumn[city]; column != -1; column = nextColumn[column]) {
+            row[column] = clampDuration<Weight>(distance);
+        }
+        return --remaining == 0 ? SearchStep::Stop : SearchStep::Expand;
+    }
+};
+
+// Function to build an origin x destination duration table for the requested cities only.
+// The table is row-major: entry [s * targets.size() + t] is the duration from sources[s] to targets[t].
+// Searches run on int durations; the table stores them as Weight, clamped at its "no path" sentinel.
+template <typename Weight = int>
+vector<Weight> manyToMany(const RouteGraph& graph, const vector<int>& sources, const vector<int>& targets, int numThreads = 0) {
+    int numCities = graph.size();
+    size_t numTargets = targets.size();
+    if (numThreads <= 0) {
+        numThreads = defaultThreadCount();
+    }
+    vector<Weight> table(sources.size() * numTargets, numeric_limits<Weight>::max());
+
+    // A city can be requested as several destinations, so chain the columns it fills
+    vector<int> firstColumn(numCities, -1);
+    vector<int> nextColumn(numTargets, -1);
+    int distinctTargets = 0;
+    for (size_t t = 0; t < numTargets; t++) {
+        if (firstColumn[targets[t]] == -1) {
+            distinctTargets++;
+        }
+        nextColumn[t] = firstColumn[targets[t]];
+        firstColumn[targets[t]] = t;
+    }
+
+    // One heap-based search per origin that stops once every destination is settled
+    if (distinctTargets == 0) {
+        return table;
+    }
+    parallelFor(sources.size(), numThreads, 1, [&](size_t begin, size_t end, int) {
+        for (size_t s = begin; s < end; s++) {
+            TableRowSearch<Weight> search{{}, firstColumn, nextColumn, &table[s * numTargets], distinctTargets};
+            pair<int, int> seed(sources[s], 0);
+            heapSearch(graph, &seed, 1, search);
+        }
+    });
+
+    return table;
+}
+
+// Search policy for reachableWithin: collect cities in the order they are settled, and drop
+// arrivals past the budget
+struct BudgetSearch : SearchDefaults {
+    int budget;
+    vector<pair<int, int>>& reachable;
+
+    int limit() const {
+        return budget;
+    }
+    SearchStep settle(int city, int distance) {
+        reachable.push_back(make_pair(city, distance));
+        return SearchStep::Expand;
+    }
+};
+
+// Function to find every city reachable from origin within budget minutes, as (city, minutes)
+// sorted by arrival time. The search stops as soon as the frontier passes the budget.
+vector<pair<int, int>> reachableWithin(const RouteGraph& graph, int origin, int budget) {
+    vector<pair<int, int>> reachable;
+    BudgetSearch search{{}, budget, reachable};
+    pair<int, int> seed(origin, 0);
+    heapSearch(graph, &seed, 1, search);
+    return reachable;
+}
+
+// Function to answer reachableWithin for many origins, spread over the worker pool. Each origin
+// is its own bounded search on the worker's pooled buffers: a shared heap over (origin, city)
+// labels was measured slower than this, since bounded searches are small and rarely overlap.
+vector<vector<pair<int, int>>> reachableWithinBatch(const RouteGraph& graph, const vector<int>& origins, int budget, int numThreads = 0) {
+    if (numThreads <= 0) {
+        numThreads = defaultThreadCount();
+    }
+    vector<vector<pair<int, int>>> reachable(origins.size());
+    parallelFor(origins.size(), numThreads, 1, [&](size_t begin, size_t end, int) {
+        for (size_t o = begin; o < end; o++) {
+            reachable[o] = reachableWithin(graph, origins[o], budget);
+        }
+    });
+    return reachable;
+}
+
+// All-pairs durations and predecessors, each in one contiguous row-major block.
+// Weight must hold the longest path, Index every city index plus the noCity marker.
+template <typename Weight, typename Index>
+struct PathMatrix {
+    static constexpr Weight unreachable = numeric_limits<Weight>::max();
+    static constexpr Index noCity = numeric_limits<Index>::max();
+
+    // Every city index must be below the noCity sentinel
+    static bool fits(int numCities) {
+        return (long long)numCities <= (long long)noCity;
+    }
+
+    int numCities = 0;
+    vector<Weight> dist;
+    vector<Index> prev; // prev[from][to] is the city before 'to' on the path from 'from'
+
+    Weight distance(int from, int to) const {
+        return dist[size_t(from) * numCities + to];
+    }
+    int predecessor(int from, int to) const {
+        Index p = prev[size_t(from) * numCities + to];
+        return p == noCity ? -1 : p;
+    }
+};
+
+// Function to find the shortest paths between all cities using Floyd-Warshall algorithm.
+// Returns an empty matrix (numCities 0) if the cities do not fit Index.
+template <typename Weight, typename Index>
+PathMatrix<Weight, Index> floydWarshall(const RouteGraph& graph) {
+    using Matrix = PathMatrix<Weight, Index>;
+    int numCities = graph.size();
+    Matrix result;
+    if (!Matrix::fits(numCities)) {
+        return result;
+    }
+    result.numCities = numCities;
+    result.dist.assign(size_t(numCities) * numCities, Matrix::unreachable);
+    result.prev.assign(size_t(numCities) * numCities, Matrix::noCity);
+
+    // Initialize distance matrix with direct connections
+    for (int i = 0; i < numCities; i++) {
+        Weight* row = &result.dist[size_t(i) * numCities];
+        row[i] = 0;
+        for (const auto& connection : graph.connections(i)) {
+            int neighbor = connection.first;
+            Weight duration = clampDuration<Weight>(connection.second);
+            if (neighbor != i && duration < row[neighbor]) {
+                row[neighbor] = duration;
+                result.prev[size_t(i) * numCities + neighbor] = Index(i);
+            }
+        }
+    }
+
+    // Floyd-Warshall algorithm; saturating adds make unreachable legs lose every comparison
+    for (int k = 0; k < numCities; k++) {
+        const Weight* rowK = &result.dist[size_t(k) * numCities];
+        const Index* prevK = &result.prev[size_t(k) * numCities];
+        for (int i = 0; i < numCities; i++) {
+            Weight* rowI = &result.dist[size_t(i) * numCities];
+            Index* prevI = &result.prev[size_t(i) * numCities];
+            Weight viaK = rowI[k];
+            if (viaK == Matrix::unreachable) {
+                continue;
+            }
+            for (int j = 0; j < numCities; j++) {
+                Weight candidate = saturatingAdd(viaK, rowK[j]);
+                if (candidate < rowI[j]) {
+                    rowI[j] = candidate;
+                    prevI[j] = prevK[j];
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+// Read-only view of a whole file: memory-mapped on POSIX systems, read into memory elsewhere
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept {
+        *this = move(other);
+    }
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            contents = other.contents;
+            length = other.length;
+            copy = move(other.copy);
+            other.contents = nullptr;
+            other.length = 0;
+        }
+        return *this;
+    }
+    ~MappedFile() {
+        close();
+    }
+
+    bool open(const string& fileName) {
+        close();
+#ifdef _WIN32
+        ifstream in(fileName, ios::binary);
+        if (!in) {
+            return false;
+        }
+        copy.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        contents = copy.data();
+        length = copy.size();
+        return length > 0;
+#else
+        int fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* address = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            return false;
+        }
+        contents = static_cast<const char*>(address);
+        length = info.st_size;
+        return true;
+#endif
+    }
+
+    void close() {
+#ifndef _WIN32
+        if (contents != nullptr) {
+            munmap(const_cast<char*>(contents), length);
+        }
+#endif
+        copy.clear();
+        contents = nullptr;
+        length = 0;
+    }
+
+    const char* data() const {
+        return contents;
+    }
+    size_t size() const {
+        return length;
+    }
+
+private:
+    const char* contents = nullptr;
+    size_t length = 0;
+    vector<char> copy; // Backing storage where the file is read instead of mapped
+};
+
+// One hub label entry: 'hub' is the hub's rank in the vertex order, 'parent' the city
+// before this one on a shortest path from the hub (-1 when the city is the hub itself)
+struct LabelEntry {
+    int32_t hub;
+    int32_t distance;
+    int32_t parent;
+};
+
+// Function to check that every flight has a return flight of the same duration
+bool isUndirected(const RouteGraph& graph) {
+    vector<tuple<int, int, int>> outbound, inbound;
+    outbound.reserve(graph.numConnections());
+    inbound.reserve(graph.numConnections());
+    for (int city = 0; city < graph.size(); city++) {
+        for (const auto& connection : graph.connections(city)) {
+            outbound.push_back(make_tuple(city, connection.first, connection.second));
+            inbound.push_back(make_tuple(connection.first, city, connection.second));
+        }
+    }
+    sort(outbound.begin(), outbound.end());
+    sort(inbound.begin(), inbound.end());
+    return outbound == inbound;
+}
+
+// Hub labeling (2-hop cover) index for undirected route graphs, built with pruned landmark labeling.
+// Any two cities share a hub on one of their shortest paths, so a query is a merge of two sorted labels.
+class HubLabels {
+    // Search policy for one hub: label every city the hub is the first to cover, and prune
+    // the search at cities a higher-ranked hub already covers
+    struct LabelSearch : SearchDefaults {
+        int hub;
+        int rank;
+        vector<vector<LabelEntry>>& labels;
+        const vector<int>& hubDistance;
+        vector<int>& parent; // Only read for cities reached in this search
+
+        void reached(int city, int predecessor) {
+            parent[city] = predecessor;
+        }
+        SearchStep settle(int city, int distance) {
+            for (const auto& entry : labels[city]) {
+                if (saturatingAdd(hubDistance[entry.hub], entry.distance) <= distance) {
+                    return SearchStep::Prune;
+                }
+            }
+            labels[city].push_back(LabelEntry{rank, distance, city == hub ? -1 : parent[city]});
+            return SearchStep::Expand;
+        }
+    };
+
+public:
+    // Build the index; returns false, leaving it empty, if the graph has one-way flights
+    // (a single forward search per hub is only a valid label for undirected graphs)
+    bool build(const RouteGraph& graph) {
+        file.close();
+        offsetStore.assign(1, 0);
+        entryStore.clear();
+        offsets = offsetStore.data();
+        entries = entryStore.data();
+        numCities = 0;
+        if (!isUndirected(graph)) {
+            return false;
+        }
+        numCities = graph.size();
+
+        // Busy airports first: they sit on the most shortest paths and prune the most later searches
+        vector<int> order(numCities);
+        for (int i = 0; i < numCities; i++) {
+            order[i] = i;
+        }
+        stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return graph.connections(a).size() > graph.connections(b).size();
+        });
+
+        vector<vector<LabelEntry>> labels(numCities);
+        QueryPool& pool = queryPool();
+        vector<int> parent = pool.ints.acquire(numCities, -1);
+        vector<int> hubDistance = pool.ints.acquire(numCities, INT_MAX); // By rank: current hub's own label
+
+        for (int rank = 0; rank < numCities; rank++) {
+            int hub = order[rank];
+            for (const auto& entry : labels[hub]) {
+                hubDistance[entry.hub] = entry.distance;
+            }
+            LabelSearch search{{}, hub, rank, labels, hubDistance, parent};
+            pair<int, int> seed(hub, 0);
+            heapSearch(graph, &seed, 1, search);
+            for (const auto& entry : labels[hub]) {
+                hubDistance[entry.hub] = INT_MAX;
+            }
+        }
+
+        pool.ints.release(move(parent));
+        pool.ints.release(move(hubDistance));
+
+        // Flatten into one offsets array and one entries array, the same layout as the file
+        for (const auto& label : labels) {
+            entryStore.insert(entryStore.end(), label.begin(), label.end());
+            offsetStore.push_back(entryStore.size());
+        }
+        offsets = offsetStore.data();
+        entries = entryStore.data();
+        return true;
+    }
+
+    // Shortest flight time between two cities, INT_MAX if there is no path
+    int distance(int from, int to) const {
+        const LabelEntry* fromEntry;
+        const LabelEntry* toEntry;
+        return meet(from, to, fromEntry, toEntry);
+    }
+
+    // Cities on a shortest path from 'from' to 'to', empty if there is no path
+    vector<int> path(int from, int to) const {
+        vector<int> front(1, from);
+        vector<int> back(1, to);
+        while (front.back() != back.back()) {
+            const LabelEntry* fromEntry;
+            const LabelEntry* toEntry;
+            if (meet(front.back(), back.back(), fromEntry, toEntry) == INT_MAX) {
+                return vector<int>();
+            }
+            // A parent in either label is one step along a shortest path towards the other end
+            if (toEntry->parent != -1) {
+                back.push_back(toEntry->parent);
+            } else {
+                front.push_back(fromEntry->parent);
+            }
+        }
+        front.insert(front.end(), back.rbegin() + 1, back.rend());
+        return front;
+    }
+
+    size_t size() const {
+        return numCities;
+    }
+    size_t numEntries() const {
+        return numCities == 0 ? 0 : offsets[numCities];
+    }
+    size_t labelSize(int city) const {
+        return offsets[city + 1] - offsets[city];
+    }
+
+    // Write the index as one flat file: header, label offsets, label entries
+    bool save(const string& fileName) const {
+        ofstream out(fileName, ios::binary);
+        Header header = {{'P', 'F', 'H', 'U', 'B', 'L', 'B', '1'}, uint32_t(numCities), uint32_t(sizeof(LabelEntry)), numEntries()};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(offsets), (numCities + 1) * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char*>(entries), numEntries() * sizeof(LabelEntry));
+        return bool(out);
+    }
+
+    // Serve the index straight from a file written by save(), without copying it. Every offset and
+    // entry is validated first, so a damaged file is rejected instead of read out of bounds.
+    bool load(const string& fileName) {
+        MappedFile mapped;
+        if (!mapped.open(fileName) || mapped.size() < sizeof(Header)) {
+            return false;
+        }
+        Header header;
+        memcpy(&header, mapped.data(), sizeof(header));
+        if (memcmp(header.magic, "PFHUBLB1", 8) != 0 || header.entrySize != sizeof(LabelEntry)
+            || header.numEntries > mapped.size() / sizeof(LabelEntry) || header.numCities >= uint32_t(INT_MAX)) {
+            return false;
+        }
+        size_t expected = sizeof(Header) + (size_t(header.numCities) + 1) * sizeof(uint64_t) + header.numEntries * sizeof(LabelEntry);
+        if (mapped.size() != expected) {
+            return false;
+        }
+
+        // Offsets must run from 0 to numEntries without going back; within a label, hubs must be
+        // strictly increasing ranks and parents must be cities
+        const uint64_t* fileOffsets = reinterpret_cast<const uint64_t*>(mapped.data() + sizeof(Header));
+        const LabelEntry* fileEntries = reinterpret_cast<const LabelEntry*>(fileOffsets + header.numCities + 1);
+        if (fileOffsets[0] != 0 || fileOffsets[header.numCities] != header.numEntries) {
+            return false;
+        }
+        int numFileCities = header.numCities;
+        for (int city = 0; city < numFileCities; city++) {
+            if (fileOffsets[city + 1] < fileOffsets[city]) {
+                return false;
+            }
+            for (uint64_t e = fileOffsets[city]; e < fileOffsets[city + 1]; e++) {
+                const LabelEntry& entry = fileEntries[e];
+                if (entry.hub < 0 || entry.hub >= numFileCities || (e > fileOffsets[city] && entry.hub <= fileEntries[e - 1].hub)
+                    || entry.distance < 0 || entry.parent < -1 || entry.parent >= numFileCities) {
+                    return false;
+                }
+            }
+        }
+
+        file = move(mapped);
+        offsetStore.clear();
+        entryStore.clear();
+        numCities = header.numCities;
+        offsets = reinterpret_cast<const uint64_t*>(file.data() + sizeof(Header));
+        entries = reinterpret_cast<const LabelEntry*>(offsets + numCities + 1);
+        return true;
+    }
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t numCities;
+        uint32_t entrySize;
+        uint64_t numEntries;
+    };
+
+    // Linear merge of both labels by hub rank; returns the distance and the winning entries
+    int meet(int from, int to, const LabelEntry*& fromEntry, const LabelEntry*& toEntry) const {
+        const LabelEntry* a = entries + offsets[from];
+        const LabelEntry* aEnd = entries + offsets[from + 1];
+        const LabelEntry* b = entries + offsets[to];
+        const LabelEntry* bEnd = entries + offsets[to + 1];
+        int best = INT_MAX;
+        while (a != aEnd && b != bEnd) {
+            if (a->hub < b->hub) {
+                a++;
+            } else if (a->hub > b->hub) {
+                b++;
+            } else {
+                int candidate = saturatingAdd(a->distance, b->distance);
+                if (candidate < best) {
+                    best = candidate;
+                    fromEntry = a;
+                    toEntry = b;
+                }
+                a++;
+                b++;
+            }
+        }
+        return best;
+    }
+
+    int numCities = 0;
+    const uint64_t* offsets = nullptr; // Label of city c is entries[offsets[c], offsets[c + 1])
+    const LabelEntry* entries = nullptr;
+    vector<uint64_t> offsetStore; // Backing storage after build()
+    vector<LabelEntry> entryStore;
+    MappedFile file;              // Backing storage after load()
+};
+
+// Function to generate a random hub-and-spoke route network for benchmarks. Every new
+// airport gets flights to routesPerCity earlier airports, mostly to ones that are already busy.
+vector<Route> generateRandomRoutes(int numCities, int routesPerCity, unsigned seed) {
+    mt19937 rng(seed);
+    uniform_int_distribution<int> durationDist(10, 999); // Same range as the interactive planner
+    vector<Route> routes;
+    routes.reserve(size_t(numCities) * routesPerCity);
+    for (int city = 1; city < numCities; city++) {
+        for (int k = 0; k < min(city, routesPerCity); k++) {
+            int other;
+            if (!routes.empty() && rng() % 4 != 0) {
+                // An endpoint of a random existing route is picked in proportion to its flights
+                const Route& route = routes[rng() % routes.size()];
+                other = (rng() & 1) ? route.from : route.to;
+            } else {
+                other = rng() % city;
+            }
+            routes.push_back(Route{city, other, durationDist(rng)});
+        }
+    }
+    return routes;
+}
+
+// Function to print hub label sizes and query latency next to dijkstra on random city pairs
+void reportHubLabels(const RouteGraph& graph, const HubLabels& labels, int numQueries, unsigned seed) {
+    mt19937 rng(seed);
+    int numCities = graph.size();
+    size_t largestLabel = 0;
+    for (int city = 0; city < numCities; city++) {
+        largestLabel = max(largestLabel, labels.labelSize(city));
+    }
+    cout << "Hub labels: " << labels.numEntries() << " entries, "
+         << double(labels.numEntries()) / max(1, numCities) << " per city on average, "
+         << largestLabel << " largest, "
+         << (labels.numEntries() * sizeof(LabelEntry) + (numCities + 1) * sizeof(uint64_t)) / 1024 << " KiB" << endl;
+
+    vector<pair<int, int>> pairs(numQueries);
+    for (auto& query : pairs) {
+        query = make_pair(int(rng() % numCities), int(rng() % numCities));
+    }
+
+    auto started = chrono::steady_clock::now();
+    long long checksum = 0;
+    for (const auto& query : pairs) {
+        checksum += labels.distance(query.first, query.second);
+    }
+    double labelMicros = chrono::duration<double, micro>(chrono::steady_clock::now() - started).count() / max(1, numQueries);
+
+    // dijkstra scans every city per step, so a handful of queries is enough to time it
+    int numDijkstra = min(numQueries, 20);
+    int mismatches = 0;
+    started = chrono::steady_clock::now();
+    for (int q = 0; q < numDijkstra; q++) {
+        vector<int> distance = dijkstra(graph, pairs[q].first, pairs[q].second, DistanceOnly());
+        if (distance[pairs[q].second] != labels.distance(pairs[q].first, pairs[q].second)) {
+            mismatches++;
+        }
+    }
+    double dijkstraMicros = chrono::duration<double, micro>(chrono::steady_clock::now() - started).count() / max(1, numDijkstra);
+
+    cout << "Hub label query: " << labelMicros << " us (checksum " << checksum << ")" << endl;
+    cout << "Dijkstra query: " << dijkstraMicros << " us, " << mismatches << " of " << numDijkstra << " distances differ" << endl;
+}
+
+// Function to generate a regional route network for benchmarks. Airports are scattered over
+// India, most flights are short hops to nearby airports, long-haul flights only link the
+// hub airports (the first 1%), and durations grow with distance.
+vector<Route> generateRegionalRoutes(int numCities, int routesPerCity, unsigned seed, vector<pair<double, double>>& locations) {
+    const double minLatitude = 8.0, maxLatitude = 34.0, minLongitude = 68.0, maxLongitude = 97.0;
+    mt19937 rng(seed);
+    uniform_real_distribution<double> latitude(minLatitude, maxLatitude);
+    uniform_real_distribution<double> longitude(minLongitude, maxLongitude);
+    locations.resize(numCities);
+    for (auto& location : locations) {
+        location = make_pair(latitude(rng), longitude(rng));
+    }
+
+    // Bucket the airports into a grid with about four per cell to find nearby ones quickly
+    int gridSize = max(1, int(sqrt(numCities / 4.0)));
+    auto cellRow = [&](int city) {
+        return min(gridSize - 1, int((locations[city].first - minLatitude) / (maxLatitude - minLatitude) * gridSize));
+    };
+    auto cellColumn = [&](int city) {
+        return min(gridSize - 1, int((locations[city].second - minLongitude) / (maxLongitude - minLongitude) * gridSize));
+    };
+    vector<vector<int>> cells(size_t(gridSize) * gridSize);
+    for (int city = 0; city < numCities; city++) {
+        cells[cellRow(city) * gridSize + cellColumn(city)].push_back(city);
+    }
+
+    vector<Route> routes;
+    routes.reserve(size_t(numCities) * routesPerCity);
+    int numHubs = max(1, numCities / 100);
+    for (int city = 0; city < numCities; city++) {
+        for (int k = 0; k < routesPerCity; k++) {
+            int other = rng() % numHubs; // One flight in three from a hub goes to another hub
+            if (city >= numHubs || rng() % 3 != 0) {
+                int row = min(gridSize - 1, max(0, cellRow(city) + int(rng() % 3) - 1));
+                int column = min(gridSize - 1, max(0, cellColumn(city) + int(rng() % 3) - 1));
+                const vector<int>& cell = cells[row * gridSize + column];
+                if (cell.empty()) {
+                    continue;
+                }
+                other = cell[rng() % cell.size()];
+            }
+            if (other == city) {
+                continue;
+            }
+
+            // About 720 km/h in the air plus half an hour on the ground
+            double dLatitude = locations[other].first - locations[city].first;
+            double dLongitude = (locations[other].second - locations[city].second) * cos(locations[city].first * acos(-1.0) / 180);
+            int duration = int(30 + 111.0 * sqrt(dLatitude * dLatitude + dLongitude * dLongitude) / 12);
+            routes.push_back(Route{city, other, min(999, max(10, duration))});
+        }
+    }
+    return routes;
+}
+
+// Ways to renumber cities so that cities with flights between them sit close together in memory
+enum class CityOrder {
+    Original,
+    Bfs,
+    ReverseCuthillMcKee,
+    Hilbert
+};
+
+// Function to compute the position of a point along a Hilbert curve over a 2^16 x 2^16 grid
+uint64_t hilbertIndex(uint32_t x, uint32_t y) {
+    const uint32_t side = 1u << 16;
+    uint64_t index = 0;
+    for (uint32_t s = side / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        index += uint64_t(s) * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            swap(x, y);
+        }
+    }
+    return index;
+}
+
+// Function to compute a new numbering of the cities: order[newIndex] is the original index
+vector<int> computeCityOrder(const RouteGraph& graph, CityOrder method, const vector<pair<double, double>>& locations) {
+    int numCities = graph.size();
+    vector<int> order;
+    order.reserve(numCities);
+
+    if (method == CityOrder::Original || (method == CityOrder::Hilbert && int(locations.size()) != numCities)) {
+        for (int city = 0; city < numCities; city++) {
+            order.push_back(city);
+        }
+        return order;
+    }
+
+    if (method == CityOrder::Hilbert) {
+        double minLatitude = 90, maxLatitude = -90, minLongitude = 180, maxLongitude = -180;
+        for (const auto& location : locations) {
+            minLatitude = min(minLatitude, location.first);
+            maxLatitude = max(maxLatitude, location.first);
+            minLongitude = min(minLongitude, location.second);
+            maxLongitude = max(maxLongitude, location.second);
+        }
+        double latitudeScale = 65535 / max(1e-9, maxLatitude - minLatitude);
+        double longitudeScale = 65535 / max(1e-9, maxLongitude - minLongitude);
+        vector<pair<uint64_t, int>> keyed(numCities);
+        for (int city = 0; city < numCities; city++) {
+            uint32_t x = uint32_t((locations[city].second - minLongitude) * longitudeScale);
+            uint32_t y = uint32_t((locations[city].first - minLatitude) * latitudeScale);
+            keyed[city] = make_pair(hilbertIndex(x, y), city);
+        }
+        sort(keyed.begin(), keyed.end());
+        for (const auto& entry : keyed) {
+            order.push_back(entry.second);
+        }
+        return order;
+    }
+
+    // Breadth-first numbering, one component at a time. Cuthill-McKee starts every component
+    // at a least-connected city and visits neighbors by increasing degree, then reverses.
+    bool cuthillMcKee = method == CityOrder::ReverseCuthillMcKee;
+    auto degree = [&](int city) {
+        return graph.connections(city).size();
+    };
+    vector<int> starts;
+    for (int city = 0; city < numCities; city++) {
+        starts.push_back(city);
+    }
+    if (cuthillMcKee) {
+        stable_sort(starts.begin(), starts.end(), [&](int a, int b) { return degree(a) < degree(b); });
+    }
+
+    vector<char> seen(numCities, false);
+    vector<int> neighbors;
+    for (int start : starts) {
+        if (seen[start]) {
+            continue;
+        }
+        seen[start] = true;
+        order.push_back(start);
+        for (size_t head = order.size() - 1; head < order.size(); head++) {
+            neighbors.clear();
+            for (const auto& connection : graph.connections(order[head])) {
+                if (!seen[connection.first]) {
+                    seen[connection.first] = true;
+                    neighbors.push_back(connection.first);
+                }
+            }
+            if (cuthillMcKee) {
+                stable_sort(neighbors.begin(), neighbors.end(), [&](int a, int b) { return degree(a) < degree(b); });
+            }
+            order.insert(order.end(), neighbors.begin(), neighbors.end());
+        }
+    }
+    if (cuthillMcKee) {
+        reverse(order.begin(), order.end());
+    }
+    return order;
+}
+
+// Renumbered copy of a route graph. Queries run on 'graph'; translate city ids at the API
+// boundary with toInternal (original -> renumbered) and toExternal (renumbered -> original).
+struct ReorderedNetwork {
+    MonotonicArena arena;
+    RouteGraph graph;
+    vector<int> toInternal;
+    vector<int> toExternal;
+};
+
+// Function to renumber a route graph by 'order', with every city's connections sorted by neighbor
+ReorderedNetwork reorderNetwork(const RouteGraph& graph, const vector<int>& order) {
+    int numCities = graph.size();
+    ReorderedNetwork result;
+    result.toExternal = order;
+    result.toInternal.resize(numCities);
+    for (int newCity = 0; newCity < numCities; newCity++) {
+        result.toInternal[order[newCity]] = newCity;
+    }
+
+    size_t numEdges = graph.numConnections();
+    result.arena.reserve((numCities + 1) * sizeof(size_t) + numEdges * sizeof(pair<int, int>) + alignof(pair<int, int>));
+    size_t* offsets = result.arena.allocate<size_t>(numCities + 1);
+    pair<int, int>* edges = result.arena.allocate<pair<int, int>>(numEdges);
+    offsets[0] = 0;
+    for (int newCity = 0; newCity < numCities; newCity++) {
+        size_t first = offsets[newCity];
+        size_t last = first;
+        for (const auto& connection : graph.connections(order[newCity])) {
+            new (&edges[last++]) pair<int, int>(result.toInternal[connection.first], connection.second);
+        }
+        sort(edges + first, edges + last);
+        offsets[newCity + 1] = last;
+    }
+
+    result.graph.numCities = numCities;
+    result.graph.offsets = offsets;
+    result.graph.edges = edges;
+    return result;
+}
+
+// Hardware cache-miss counter for the calling thread; stop() returns -1 where perf events are unavailable
+class CacheMissCounter {
+public:
+    CacheMissCounter() {
+#ifdef __linux__
+        perf_event_attr attributes;
+        memset(&attributes, 0, sizeof(attributes));
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.size = sizeof(attributes);
+        attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+        attributes.disabled = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        fd = syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+#endif
+    }
+    CacheMissCounter(const CacheMissCounter&) = delete;
+    CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+    ~CacheMissCounter() {
+#ifdef __linux__
+        if (fd >= 0) {
+            ::close(fd);
+        }
+#endif
+    }
+
+    void start() {
+#ifdef __linux__
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    long long stop() {
+        long long count = -1;
+#ifdef __linux__
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+                count = -1;
+            }
+        }
+#endif
+        return count;
+    }
+
+private:
+    int fd = -1;
+};
+
+// Immutable network snapshot: the graph, its names and its precomputed indices are
+// built together and never change once published
+struct NetworkSnapshot {
+    uint64_t version = 0;
+    MonotonicArena arena;
+    RouteGraph graph;
+    AirportCatalog airports;
+    HubLabels labels;
+};
+
+// Function to build a snapshot for a route network between the catalog's airports, optionally
+// with its hub label index
+unique_ptr<NetworkSnapshot> buildSnapshot(const AirportCatalog& airports, const vector<Route>& routes, bool withLabels) {
+    unique_ptr<NetworkSnapshot> snapshot(new NetworkSnapshot());
+    snapshot->airports = airports;
+    snapshot->graph = buildRouteGraph(snapshot->arena, airports.size(), routes);
+    if (withLabels) {
+        snapshot->labels.build(snapshot->graph);
+    }
+    return snapshot;
+}
+
+// Publishes network snapshots to readers that do not lock. Writers swap in a new snapshot
+// atomically; a replaced one is freed by epoch-based reclamation once no query that could have
+// seen it is still running. Freeing a whole network is left to the writer and to a background
+// reclaimer thread: a reader whose guard ends while snapshots are pending only wakes it.
+class SnapshotStore {
+public:
+    static const int maxReaders = 256; // Queries in flight at the same time
+
+    // Pins one snapshot for the duration of a query
+    class ReadGuard {
+    public:
+        ReadGuard() = default;
+        ReadGuard(const SnapshotStore* store, atomic<uint64_t>* slot, const NetworkSnapshot* snapshot)
+            : store(store), slot(slot), snapshot(snapshot) {}
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+        ReadGuard(ReadGuard&& other) noexcept : store(other.store), slot(other.slot), snapshot(other.snapshot) {
+            other.slot = nullptr;
+        }
+        ~ReadGuard() {
+            if (slot != nullptr) {
+                // Sequentially consistent, paired with publish(): either the writer sees this slot
+                // idle, or this reader sees the retired snapshot and wakes the reclaimer
+                slot->store(idle);
+                if (store->numRetired.load() != 0) {
+                    store->reclaimRequested.store(true);
+                    store->reclaimWake.notify_one();
+                }
+            }
+        }
+
+        const NetworkSnapshot& operator*() const {
+            return *snapshot;
+        }
+        const NetworkSnapshot* operator->() const {
+            return snapshot;
+        }
+        explicit operator bool() const {
+            return snapshot != nullptr;
+        }
+
+    private:
+        const SnapshotStore* store = nullptr;
+        atomic<uint64_t>* slot = nullptr;
+        const NetworkSnapshot* snapshot = nullptr;
+    };
+
+    SnapshotStore() {
+        for (auto& slot : readerEpochs) {
+            slot.store(idle, memory_order_relaxed);
+        }
+    }
+    SnapshotStore(const SnapshotStore&) = delete;
+    SnapshotStore& operator=(const SnapshotStore&) = delete;
+    ~SnapshotStore() {
+        {
+            lock_guard<mutex> lock(reclaimMutex);
+            stopping = true;
+        }
+        reclaimWake.notify_one();
+        if (reclaimer.joinable()) {
+            reclaimer.join();
+        }
+        delete current.load();
+        for (const auto& entry : retired) {
+            delete entry.first;
+        }
+    }
+
+    // Pin the current snapshot. Lock-free and bounded: one pass over the reader slots, claiming an
+    // idle one with a compare-exchange. Returns an empty guard if maxReaders queries are already in
+    // flight; the caller should shed or retry the query.
+    ReadGuard acquire() const {
+        static atomic<unsigned> nextHint(0);
+        thread_local unsigned hint = nextHint.fetch_add(1, memory_order_relaxed);
+        uint64_t announced = epoch.load();
+        for (unsigned i = 0; i < unsigned(maxReaders); i++) {
+            atomic<uint64_t>& slot = readerEpochs[(hint + i) % maxReaders];
+            uint64_t expected = idle;
+            if (slot.load(memory_order_relaxed) == idle && slot.compare_exchange_strong(expected, announced)) {
+                // Announced before loading: a writer that missed this slot already swapped the pointer
+                return ReadGuard(this, &slot, current.load());
+            }
+        }
+        return ReadGuard();
+    }
+
+    // Publish a new snapshot; the one it replaces is reclaimed after its last reader finishes
+    void publish(unique_ptr<NetworkSnapshot> snapshot) {
+        lock_guard<mutex> lock(writerMutex);
+        snapshot->version = ++lastVersion;
+        const NetworkSnapshot* old = current.exchange(snapshot.release());
+        uint64_t retireEpoch = epoch.fetch_add(1) + 1;
+        if (old != nullptr) {
+            lock_guard<mutex> retiredLock(retiredMutex);
+            retired.push_back(make_pair(old, retireEpoch));
+            numRetired.fetch_add(1);
+        }
+        if (collect() != 0) {
+            if (!reclaimer.joinable()) {
+                reclaimer = thread([this]() { reclaimLoop(); });
+            }
+            {
+                lock_guard<mutex> lock(reclaimMutex);
+                reclaimRequested.store(true);
+            }
+            reclaimWake.notify_one();
+        }
+    }
+
+    // Build the next snapshot on a background thread and publish it when it is ready
+    thread reloadInBackground(function<unique_ptr<NetworkSnapshot>()> build) {
+        return thread([this, build]() { publish(build()); });
+    }
+
+    // Free retired snapshots no reader can still hold; returns how many are still pending.
+    // retiredMutex only covers picking them out, the snapshots are deleted after it is released.
+    size_t collect() const {
+        vector<const NetworkSnapshot*> freed;
+        size_t kept = 0;
+        {
+            lock_guard<mutex> lock(retiredMutex);
+            uint64_t oldestReader = idle;
+            for (const auto& slot : readerEpochs) {
+                oldestReader = min(oldestReader, slot.load());
+            }
+            // Readers that announced an epoch at or after the retirement cannot hold the old pointer
+            for (const auto& entry : retired) {
+                if (entry.second <= oldestReader) {
+                    freed.push_back(entry.first);
+                } else {
+                    retired[kept++] = entry;
+                }
+            }
+            retired.resize(kept);
+            numRetired.store(kept);
+        }
+        for (const NetworkSnapshot* snapshot : freed) {
+            delete snapshot;
+        }
+        reclaimed.fetch_add(freed.size(), memory_order_relaxed);
+        return kept;
+    }
+
+    // Wait up to timeout for every retired snapshot to be freed; returns whether they were
+    bool waitForReclaim(chrono::milliseconds timeout) const {
+        auto deadline = chrono::steady_clock::now() + timeout;
+        while (numRetired.load() != 0 && chrono::steady_clock::now() < deadline) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        return numRetired.load() == 0;
+    }
+
+    size_t numPending() const {
+        return numRetired.load();
+    }
+    size_t numReclaimed() const {
+        return reclaimed.load(memory_order_relaxed);
+    }
+
+private:
+    static const uint64_t idle = UINT64_MAX;
+
+    // Background reclaimer: frees snapshots when a reader or writer asks. Readers signal without
+    // the mutex, so a wake-up can be missed; while snapshots are pending it also polls.
+    void reclaimLoop() {
+        unique_lock<mutex> lock(reclaimMutex);
+        auto woken = [this]() { return stopping || reclaimRequested.load(); };
+        while (!stopping) {
+            if (numRetired.load() == 0) {
+                reclaimWake.wait(lock, woken);
+            } else {
+                reclaimWake.wait_for(lock, chrono::milliseconds(5), woken);
+            }
+            reclaimRequested.store(false);
+            lock.unlock();
+            collect();
+            lock.lock();
+        }
+    }
+
+    atomic<const NetworkSnapshot*> current{nullptr};
+    atomic<uint64_t> epoch{0};
+    mutable atomic<uint64_t> readerEpochs[maxReaders];
+    mutex writerMutex; // Serializes writers
+    uint64_t lastVersion = 0;
+    // Reclamation state; collect() is const so readers of a const store can still run it
+    mutable mutex retiredMutex; // Guards retired; never taken by a reader's guard
+    mutable vector<pair<const NetworkSnapshot*, uint64_t>> retired; // (snapshot, epoch it was retired in)
+    mutable atomic<size_t> numRetired{0};
+    mutable atomic<size_t> reclaimed{0};
+    thread reclaimer; // Started by the first publish that leaves a snapshot pending
+    mutex reclaimMutex; // Guards stopping and the reclaimer's sleep
+    mutable condition_variable reclaimWake;
+    mutable atomic<bool> reclaimRequested{false};
+    bool stopping = false;
+};
+
+// Function to hash bytes with 64-bit FNV-1a, used to checksum persisted tables
+uint64_t fnv1a(const char* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Function to fingerprint a network's cities and flights, so a persisted table is only
+// served for the network it was computed on
+uint64_t networkFingerprint(const RouteGraph& graph) {
+    uint64_t numCities = graph.size();
+    uint64_t hash = fnv1a(reinterpret_cast<const char*>(&numCities), sizeof(numCities));
+    if (graph.size() == 0) {
+        return hash;
+    }
+    hash = fnv1a(reinterpret_cast<const char*>(graph.offsets), (graph.size() + 1) * sizeof(size_t), hash);
+    return fnv1a(reinterpret_cast<const char*>(graph.edges), graph.numConnections() * sizeof(pair<int, int>), hash);
+}
+
+// Header of a persisted all-pairs table. It is followed by one checksum per block of
+// rows, then the distance matrix and the predecessor matrix, each row-major.
+// headerChecksum covers the header (with that field zeroed) and the block checksums.
+struct AllPairsHeader {
+    char magic[8];
+    uint32_t numCities;
+    uint16_t weightBytes;
+    uint16_t indexBytes;
+    uint32_t rowsPerBlock;
+    uint32_t numBlocks;
+    uint64_t fingerprint; // networkFingerprint of the network the table was computed on
+    uint64_t headerChecksum;
+};
+
+// Function to checksum a header and the block checksums that follow it
+uint64_t allPairsHeaderChecksum(AllPairsHeader header, const char* blockChecksums) {
+    header.headerChecksum = 0;
+    uint64_t hash = fnv1a(reinterpret_cast<const char*>(&header), sizeof(header));
+    return fnv1a(blockChecksums, header.numBlocks * sizeof(uint64_t), hash);
+}
+
+// Function to compute where the matrices start in a persisted all-pairs table, 8-byte aligned
+void allPairsLayout(const AllPairsHeader& header, size_t& distOffset, size_t& prevOffset, size_t& fileSize) {
+    size_t cells = size_t(header.numCities) * header.numCities;
+    distOffset = sizeof(AllPairsHeader) + header.numBlocks * sizeof(uint64_t);
+    prevOffset = (distOffset + cells * header.weightBytes + 7) / 8 * 8;
+    fileSize = prevOffset + cells * header.indexBytes;
+}
+
+// Function to write a Floyd-Warshall result to disk so later processes can map it instead of recomputing.
+// fingerprint is networkFingerprint of the network the paths were computed on.
+template <typename Weight, typename Index>
+bool saveAllPairs(const PathMatrix<Weight, Index>& paths, uint64_t fingerprint, const string& fileName, int rowsPerBlock = 64) {
+    AllPairsHeader header = {{'P', 'F', 'A', 'P', 'S', 'P', '0', '2'}, uint32_t(paths.numCities),
+                             uint16_t(sizeof(Weight)), uint16_t(sizeof(Index)), uint32_t(rowsPerBlock),
+                             uint32_t((paths.numCities + rowsPerBlock - 1) / rowsPerBlock), fingerprint, 0};
+    size_t distOffset, prevOffset, fileSize;
+    allPairsLayout(header, distOffset, prevOffset, fileSize);
+
+    // Each block's checksum covers its rows of both matrices
+    size_t n = paths.numCities;
+    vector<uint64_t> checksums(header.numBlocks);
+    for (size_t block = 0; block < header.numBlocks; block++) {
+        size_t firstRow = block * rowsPerBlock;
+        size_t numRows = min<size_t>(rowsPerBlock, n - firstRow);
+        uint64_t hash = fnv1a(reinterpret_cast<const char*>(&paths.dist[firstRow * n]), numRows * n * sizeof(Weight));
+        checksums[block] = fnv1a(reinterpret_cast<const char*>(&paths.prev[firstRow * n]), numRows * n * sizeof(Index), hash);
+    }
+    header.headerChecksum = allPairsHeaderChecksum(header, reinterpret_cast<const char*>(checksums.data()));
+
+    ofstream out(fileName, ios::binary);
+    const char padding[8] = {0};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(checksums.data()), checksums.size() * sizeof(uint64_t));
+    out.write(reinterpret_cast<const char*>(paths.dist.data()), paths.dist.size() * sizeof(Weight));
+    out.write(padding, prevOffset - distOffset - paths.dist.size() * sizeof(Weight));
+    out.write(reinterpret_cast<const char*>(paths.prev.data()), paths.prev.size() * sizeof(Index));
+    return bool(out);
+}
+
+// Read-only all-pairs table served straight from a file written by saveAllPairs.
+// A lookup is a couple of memory reads; nothing is loaded up front.
+template <typename Weight, typename Index>
+class MappedAllPairs {
+public:
+    static constexpr Weight unreachable = PathMatrix<Weight, Index>::unreachable;
+
+    // Map the file if it was computed on the network with this fingerprint. The header is always
+    // checked; with verify, every block checksum is checked before it is served.
+    bool open(const string& fileName, uint64_t expectedFingerprint, bool verify = true) {
+        MappedFile mapped;
+        if (!mapped.open(fileName) || mapped.size() < sizeof(AllPairsHeader)) {
+            return false;
+        }
+        AllPairsHeader fileHeader;
+        memcpy(&fileHeader, mapped.data(), sizeof(fileHeader));
+        size_t distOffset, prevOffset, fileSize;
+        allPairsLayout(fileHeader, distOffset, prevOffset, fileSize);
+        if (memcmp(fileHeader.magic, "PFAPSP02", 8) != 0 || fileHeader.weightBytes != sizeof(Weight) ||
+            fileHeader.indexBytes != sizeof(Index) || fileHeader.rowsPerBlock == 0 ||
+            fileHeader.numBlocks != (uint64_t(fileHeader.numCities) + fileHeader.rowsPerBlock - 1) / fileHeader.rowsPerBlock ||
+            mapped.size() != fileSize || fileHeader.fingerprint != expectedFingerprint ||
+            allPairsHeaderChecksum(fileHeader, mapped.data() + sizeof(AllPairsHeader)) != fileHeader.headerChecksum) {
+            return false;
+        }
+
+        file = move(mapped);
+        header = fileHeader;
+        dist = reinterpret_cast<const Weight*>(file.data() + distOffset);
+        prev = reinterpret_cast<const Index*>(file.data() + prevOffset);
+        for (size_t block = 0; verify && block < header.numBlocks; block++) {
+            if (!verifyBlock(block)) {
+                file.close();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Recompute one block's checksum against the one stored in the file
+    bool verifyBlock(size_t block) const {
+        size_t n = header.numCities;
+        size_t firstRow = block * header.rowsPerBlock;
+        size_t numRows = min<size_t>(header.rowsPerBlock, n - firstRow);
+        uint64_t stored;
+        memcpy(&stored, file.data() + sizeof(AllPairsHeader) + block * sizeof(uint64_t), sizeof(stored));
+        uint64_t hash = fnv1a(reinterpret_cast<const char*>(dist + firstRow * n), numRows * n * sizeof(Weight));
+        return fnv1a(reinterpret_cast<const char*>(prev + firstRow * n), numRows * n * sizeof(Index), hash) == stored;
+    }
+
+    int size() const {
+        return header.numCities;
+    }
+    Weight distance(int from, int to) const {
+        return dist[size_t(from) * header.numCities + to];
+    }
+    int predecessor(int from, int to) const {
+        Index p = prev[size_t(from) * header.numCities + to];
+        return p == PathMatrix<Weight, Index>::noCity ? -1 : p;
+    }
+
+    // Cities on the shortest path, walked backwards through the predecessor matrix. The walk
+    // is capped at size() steps, and a missing predecessor ends it with an empty path, so an
+    // unverified damaged block cannot make it loop or read outside the table.
+    vector<int> path(int from, int to) const {
+        vector<int> cities;
+        if (distance(from, to) == unreachable) {
+            return cities;
+        }
+        for (int city = to; city != from; city = predecessor(from, city)) {
+            if (city < 0 || city >= size() || int(cities.size()) >= size()) {
+                return vector<int>();
+            }
+            cities.push_back(city);
+        }
+        cities.push_back(from);
+        reverse(cities.begin(), cities.end());
+        return cities;
+    }
+
+private:
+    MappedFile file;
+    AllPairsHeader header = {};
+    const Weight* dist = nullptr;
+    const Index* prev = nullptr;
+};
+
+// Fewest-flights answers for a batch of origins, one row of numCities entries per origin
+struct HopTable {
+    static constexpr uint16_t unreachable = UINT16_MAX;
+
+    int numCities = 0;
+    vector<int> origins;
+    vector<uint16_t> hops;  // hops[o * numCities + city]: fewest flights from origins[o]
+    vector<int32_t> parent; // parent[o * numCities + city]: city before it on such a path (if tracked)
+
+    int hopCount(int originIndex, int city) const {
+        uint16_t h = hops[size_t(originIndex) * numCities + city];
+        return h == unreachable ? -1 : h;
+    }
+
+    // One representative fewest-flights itinerary, empty if unreachable or paths were not tracked
+    vector<int> path(int originIndex, int city) const {
+        vector<int> cities;
+        if (parent.empty() || hopCount(originIndex, city) == -1) {
+            return cities;
+        }
+        for (int at = city; at != -1; at = parent[size_t(originIndex) * numCities + at]) {
+            cities.push_back(at);
+        }
+        reverse(cities.begin(), cities.end());
+        return cities;
+    }
+};
+
+// Function to find the fewest flights from many origins with bit-parallel breadth-first search.
+// Each word holds one bit per origin, so 64 origins share a single pass over the graph;
+// batches of 64 run on separate threads.
+HopTable minHopBatch(const RouteGraph& graph, const vector<int>& origins, bool trackPaths = true, int numThreads = 0) {
+    int numCities = graph.size();
+    HopTable table;
+    table.numCities = numCities;
+    table.origins = origins;
+    table.hops.assign(origins.size() * numCities, HopTable::unreachable);
+    if (trackPaths) {
+        table.parent.assign(origins.size() * numCities, -1);
+    }
+    if (numThreads <= 0) {
+        numThreads = defaultThreadCount();
+    }
+
+    size_t numBatches = (origins.size() + 63) / 64;
+    parallelFor(numBatches, numThreads, 1, [&](size_t firstBatch, size_t lastBatch, int) {
+        vector<uint64_t> seen(numCities), frontier(numCities), next(numCities);
+        vector<int> active, nextActive;
+        for (size_t batch = firstBatch; batch < lastBatch; batch++) {
+            size_t firstOrigin = batch * 64;
+            int batchSize = min<size_t>(64, origins.size() - firstOrigin);
+            fill(seen.begin(), seen.end(), 0);
+            active.clear();
+            for (int bit = 0; bit < batchSize; bit++) {
+                int origin = origins[firstOrigin + bit];
+                if (frontier[origin] == 0) {
+                    active.push_back(origin);
+                }
+                frontier[origin] |= uint64_t(1) << bit;
+                seen[origin] |= uint64_t(1) << bit;
+                table.hops[(firstOrigin + bit) * numCities + origin] = 0;
+            }
+
+            for (int level = 1; !active.empty(); level++) {
+                nextActive.clear();
+                for (int u : active) {
+                    for (const auto& connection : graph.connections(u)) {
+                        int v = connection.first;
+                        uint64_t fresh = frontier[u] & ~seen[v] & ~next[v];
+                        if (fresh == 0) {
+                            continue;
+                        }
+                        if (next[v] == 0) {
+                            nextActive.push_back(v);
+                        }
+                        next[v] |= fresh;
+                        for (uint64_t bits = fresh; bits != 0 && trackPaths; bits &= bits - 1) {
+                            table.parent[(firstOrigin + __builtin_ctzll(bits)) * numCities + v] = u;
+                        }
+                    }
+                }
+                for (int u : active) {
+                    frontier[u] = 0;
+                }
+                for (int v : nextActive) {
+                    seen[v] |= next[v];
+                    for (uint64_t bits = next[v]; bits != 0; bits &= bits - 1) {
+                        table.hops[(firstOrigin + __builtin_ctzll(bits)) * numCities + v] = uint16_t(min(level, int(HopTable::unreachable) - 1));
+                    }
+                    frontier[v] = next[v];
+                    next[v] = 0;
+                }
+                swap(active, nextActive);
+            }
+        }
+    });
+    return table;
+}
+
+// Approximate distance oracle for undirected route graphs: exact durations from a few landmark
+// airports bound every pair from above (via a landmark) and below (triangle inequality).
+// Memory is numLandmarks ints per city, so more landmarks buy tighter estimates.
+class LandmarkOracle {
+public:
+    // Build the oracle; returns false, leaving it empty, if the graph has one-way flights. A search
+    // from a landmark only gives durations towards the cities there, and both bounds need them
+    // in either direction. An empty oracle estimates INT_MAX and bounds every pair below by 0.
+    bool build(const RouteGraph& graph, int numLandmarks, int numThreads = 0) {
+        numCities = 0;
+        this->numLandmarks = 0;
+        builtOn = nullptr;
+        landmarkCities.clear();
+        distance.clear();
+        if (!isUndirected(graph)) {
+            return false;
+        }
+        numCities = graph.size();
+        builtOn = graph.offsets;
+        numLandmarks = min(numLandmarks, numCities);
+        distance.assign(size_t(numCities) * numLandmarks, INT_MAX);
+
+        // Landmarks are the busiest airports, since most shortest routes pass through a hub; a
+        // city no landmark reaches yet takes the next slot so every island gets a landmark
+        vector<int> byTraffic(numCities);
+        for (int city = 0; city < numCities; city++) {
+            byTraffic[city] = city;
+        }
+        stable_sort(byTraffic.begin(), byTraffic.end(), [&graph](int a, int b) {
+            return graph.connections(a).size() > graph.connections(b).size();
+        });
+        vector<char> reached(numCities, 0), chosen(numCities, 0);
+        size_t nextHub = 0;
+        for (int l = 0; l < numLandmarks; l++) {
+            int next = -1;
+            for (int city : byTraffic) {
+                if (!reached[city] && graph.connections(city).size() > 0) {
+                    next = city;
+                    break;
+                }
+            }
+            if (next == -1) {
+                while (chosen[byTraffic[nextHub]]) {
+                    nextHub++;
+                }
+                next = byTraffic[nextHub];
+            }
+            chosen[next] = 1;
+            landmarkCities.push_back(next);
+            vector<int> fromLandmark = deltaStepping(graph, next, DistanceOnly(), numThreads);
+            for (int city = 0; city < numCities; city++) {
+                distance[size_t(city) * numLandmarks + l] = fromLandmark[city];
+                reached[city] |= fromLandmark[city] != INT_MAX;
+            }
+        }
+        this->numLandmarks = numLandmarks;
+        return true;
+    }
+
+    // Upper bound on the shortest duration: the best route through one landmark, INT_MAX if none
+    int estimate(int from, int to) const {
+        if (from == to) {
+            return 0;
+        }
+        const int* a = distance.data() + size_t(from) * numLandmarks;
+        const int* b = distance.data() + size_t(to) * numLandmarks;
+        int best = INT_MAX;
+        for (int l = 0; l < numLandmarks; l++) {
+            best = min(best, saturatingAdd(a[l], b[l]));
+        }
+        return best;
+    }
+
+    // Lower bound on the shortest duration from the triangle inequality
+    int lowerBound(int from, int to) const {
+        const int* a = distance.data() + size_t(from) * numLandmarks;
+        const int* b = distance.data() + size_t(to) * numLandmarks;
+        int best = 0;
+        for (int l = 0; l < numLandmarks; l++) {
+            if (a[l] != INT_MAX && b[l] != INT_MAX) {
+                best = max(best, abs(a[l] - b[l]));
+            }
+        }
+        return best;
+    }
+
+    // Whether the bounds hold on this graph: the oracle was built on it and accepted it
+    bool covers(const RouteGraph& graph) const {
+        return builtOn != nullptr && graph.offsets == builtOn && graph.size() == numCities;
+    }
+
+    const vector<int>& landmarks() const {
+        return landmarkCities;
+    }
+    size_t memoryBytes() const {
+        return distance.size() * sizeof(int) + landmarkCities.size() * sizeof(int);
+    }
+
+private:
+    int numCities = 0;
+    int numLandmarks = 0;
+    const size_t* builtOn = nullptr; // Offsets of the graph it was built on, null if none was accepted
+    vector<int> landmarkCities;
+    vector<int> distance; // distance[city * numLandmarks + l]: duration between city and landmark l
+};
+
+// Function to print the oracle's memory, query latency and error against exact searches on
+// sampled pairs (numSamples destinations spread over numOrigins origins)
+void reportLandmarkOracle(const RouteGraph& graph, const LandmarkOracle& oracle, int numOrigins, int numSamples, unsigned seed) {
+    mt19937 rng(seed);
+    int numCities = graph.size();
+    vector<pair<int, int>> pairs(numSamples);
+    for (int q = 0; q < numSamples; q++) {
+        pairs[q] = make_pair(int(q * numOrigins / numSamples * 7919 % numCities), int(rng() % numCities));
+    }
+
+    long long checksum = 0;
+    auto started = chrono::steady_clock::now();
+    for (int repeat = 0; repeat < 100; repeat++) {
+        for (const auto& query : pairs) {
+            checksum += oracle.estimate(query.first, query.second);
+        }
+    }
+    double queryNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - started).count() / (100.0 * max(1, numSamples));
+
+    // Exact answers from the same search dijkstra would do, one per origin
+    double totalError = 0, worstError = 0;
+    int numExact = 0, numCompared = 0;
+    vector<int> exact;
+    for (size_t q = 0; q < pairs.size(); q++) {
+        if (q == 0 || pairs[q].first != pairs[q - 1].first) {
+            exact = deltaStepping(graph, pairs[q].first, DistanceOnly());
+        }
+        int truth = exact[pairs[q].second];
+        if (truth == INT_MAX || truth == 0) {
+            continue;
+        }
+        double error = double(oracle.estimate(pairs[q].first, pairs[q].second)) / truth - 1;
+        totalError += error;
+        worstError = max(worstError, error);
+        numExact += error == 0;
+        numCompared++;
+    }
+
+    cout << "Landmark oracle: " << oracle.landmarks().size() << " landmarks, " << oracle.memoryBytes() / 1024 << " KiB, "
+         << queryNanos << " ns per query (checksum " << checksum << ")" << endl;
+    cout << "Error over " << numCompared << " sampled pairs: mean " << 100 * totalError / max(1, numCompared)
+         << "%, worst " << 100 * worstError << "%, exact " << 100.0 * numExact / max(1, numCompared) << "%" << endl;
+}
+
+// Goal policies for shortestRoute: NoGoal searches outward evenly like dijkstra, LandmarkGoal
+// steers towards the destination with the oracle's lower bounds (A* with landmarks). Its
+// bounds only hold on the undirected network the oracle was built on, so it refuses any other.
+struct NoGoal {
+    static constexpr bool enabled = false;
+    bool guides(const RouteGraph&) const {
+        return true;
+    }
+    int lowerBound(int, int) const {
+        return 0;
+    }
+};
+struct LandmarkGoal {
+    static constexpr bool enabled = true;
+    const LandmarkOracle& oracle;
+    bool guides(const RouteGraph& graph) const {
+        return oracle.covers(graph);
+    }
+    int lowerBound(int city, int destination) const {
+        return oracle.lowerBound(city, destination);
+    }
+};
+
+// Constraint policies for shortestRoute: Unconstrained takes every flight, MaxLegDuration skips
+// flights longer than the aircraft can stay in the air
+struct Unconstrained {
+    static constexpr bool enabled = false;
+    bool allows(int) const {
+        return true;
+    }
+};
+struct MaxLegDuration {
+    static constexpr bool enabled = true;
+    int limit;
+    bool allows(int duration) const {
+        return duration <= limit;
+    }
+};
+
+// Search policy for shortestRoute, built from its path, goal and constraint policies
+template <typename Paths, typename Goal, typename Constraint>
+struct RouteSearch : SearchDefaults {
+    static constexpr bool goalDirected = Goal::enabled;
+    static constexpr bool constrained = Constraint::enabled;
+    const Paths& paths;
+    const Goal& goal;
+    const Constraint& constraint;
+    int end;
+    int result = INT_MAX;
+
+    int lowerBound(int city) const {
+        return goal.lowerBound(city, end);
+    }
+    bool allows(int duration) const {
+        return constraint.allows(duration);
+    }
+    void reached(int city, int predecessor) {
+        if constexpr (Paths::enabled) {
+            paths.record(city, predecessor);
+        }
+    }
+    SearchStep settle(int city, int distance) {
+        if (city != end) {
+            return SearchStep::Expand;
+        }
+        result = distance;
+        return SearchStep::Stop;
+    }
+};
+
+// Function to find the shortest duration from start to end, stopping as soon as end is settled.
+// The policies decide what the relaxation loop does, and the ones a query does not use compile
+// out of it. Returns INT_MAX if end cannot be reached, and -1 if the goal cannot guide a search
+// on this graph (a landmark oracle not built on it, or one that refused it).
+template <typename Paths, typename Goal, typename Constraint>
+int shortestRoute(const RouteGraph& graph, int start, int end, const Paths& paths, const Goal& goal, const Constraint& constraint) {
+    if (!goal.guides(graph)) {
+        return -1;
+    }
+    RouteSearch<Paths, Goal, Constraint> search{{}, paths, goal, constraint, end};
+    pair<int, int> seed(start, 0);
+    heapSearch(graph, &seed, 1, search);
+    return search.result;
+}
+
+// Function to split the cities into numRegions balanced regions with few flights between them.
+// Regions start as contiguous ranges of city indices, which are compact after a locality
+// reordering (computeCityOrder), then cities move to the region most of their flights go to.
+vector<int> partitionCities(const RouteGraph& graph, int numRegions, int refinementPasses = 4) {
+    int numCities = graph.size();
+    numRegions = max(1, numRegions);
+    vector<int> regionOf(numCities);
+    vector<int> regionSize(numRegions, 0);
+    for (int city = 0; city < numCities; city++) {
+        regionOf[city] = int(static_cast<long long>(city) * numRegions / max(1, numCities));
+        regionSize[regionOf[city]]++;
+    }
+
+    // Greedy refinement: a move must cut more flights than it adds and keep regions within 3% of even
+    int maxSize = int(1.03 * numCities / numRegions) + 1;
+    vector<int> flightsTo(numRegions, 0);
+    for (int pass = 0; pass < refinementPasses; pass++) {
+        int moved = 0;
+        for (int city = 0; city < numCities; city++) {
+            for (const auto& connection : graph.connections(city)) {
+                flightsTo[regionOf[connection.first]]++;
+            }
+            int current = regionOf[city];
+            int best = current;
+            for (const auto& connection : graph.connections(city)) {
+                int region = regionOf[connection.first];
+                if (flightsTo[region] > flightsTo[best] && regionSize[region] < maxSize) {
+                    best = region;
+                }
+            }
+            for (const auto& connection : graph.connections(city)) {
+                flightsTo[regionOf[connection.first]] = 0;
+            }
+            if (best != current && regionSize[current] > 1) {
+                regionSize[current]--;
+                regionSize[best]++;
+                regionOf[city] = best;
+                moved++;
+            }
+        }
+        if (moved == 0) {
+            break;
+        }
+    }
+    return regionOf;
+}
+
+#ifndef _WIN32
+// A peer that has exited must fail the send, not kill this process with SIGPIPE
+#ifdef MSG_NOSIGNAL
+const int sendFlags = MSG_NOSIGNAL;
+#else
+const int sendFlags = 0; // The sockets get SO_NOSIGPIPE instead
+#endif
+
+// Function to send one length-prefixed message of integers over a socket
+bool writeMessage(int socket, const vector<int32_t>& message) {
+    uint32_t length = message.size();
+    const char* parts[2] = {reinterpret_cast<const char*>(&length), reinterpret_cast<const char*>(message.data())};
+    size_t sizes[2] = {sizeof(length), message.size() * sizeof(int32_t)};
+    for (int part = 0; part < 2; part++) {
+        for (size_t sent = 0; sent < sizes[part];) {
+            ssize_t n = send(socket, parts[part] + sent, sizes[part] - sent, sendFlags);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            sent += n;
+        }
+    }
+    return true;
+}
+
+// Function to receive one length-prefixed message of integers from a socket
+bool readMessage(int socket, vector<int32_t>& message) {
+    uint32_t length;
+    char* parts[2] = {reinterpret_cast<char*>(&length), nullptr};
+    size_t sizes[2] = {sizeof(length), 0};
+    for (int part = 0; part < 2; part++) {
+        if (part == 1) {
+            message.resize(length);
+            parts[1] = reinterpret_cast<char*>(message.data());
+            sizes[1] = length * sizeof(int32_t);
+        }
+        for (size_t received = 0; received < sizes[part];) {
+            ssize_t n = recv(socket, parts[part] + received, sizes[part] - received, 0);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            received += n;
+        }
+    }
+    return true;
+}
+
+// Requests a shard process answers, sent as the first integer of a message
+enum ShardRequest {
+    ShardBoundaryTable, // -> boundary cities, then their intra-region distance matrix
+    ShardForward,       // city -> intra-region durations from city to each boundary city
+    ShardBackward,      // city -> intra-region durations from each boundary city to city
+    ShardPair,          // from, to -> intra-region duration
+    ShardQuit
+};
+
+// Function to run one shard: it keeps only its region's flights, precomputes the durations
+// between its boundary cities, and answers coordinator requests until told to quit
+void runShardProcess(int socket, const RouteGraph& graph, const vector<int>& regionOf, int region) {
+    int numCities = graph.size();
+    vector<int> localIndex(numCities, -1);
+    vector<int> cities;
+    for (int city = 0; city < numCities; city++) {
+        if (regionOf[city] == region) {
+            localIndex[city] = cities.size();
+            cities.push_back(city);
+        }
+    }
+
+    // A boundary city has a flight to or from another region
+    vector<Route> forwardRoutes, backwardRoutes;
+    vector<char> isBoundary(cities.size(), false);
+    for (int local = 0; local < int(cities.size()); local++) {
+        for (const auto& connection : graph.connections(cities[local])) {
+            int other = localIndex[connection.first];
+            if (other == -1) {
+                isBoundary[local] = true;
+                continue;
+            }
+            forwardRoutes.push_back(Route{local, other, connection.second});
+            backwardRoutes.push_back(Route{other, local, connection.second});
+        }
+    }
+    for (int city = 0; city < numCities; city++) {
+        for (const auto& connection : graph.connections(city)) {
+            if (regionOf[city] != region && localIndex[connection.first] != -1) {
+                isBoundary[localIndex[connection.first]] = true;
+            }
+        }
+    }
+    vector<int> boundary;
+    for (int local = 0; local < int(cities.size()); local++) {
+        if (isBoundary[local]) {
+            boundary.push_back(local);
+        }
+    }
+
+    MonotonicArena arena;
+    RouteGraph forward = buildRouteGraph(arena, cities.size(), forwardRoutes, false);
+    RouteGraph backward = buildRouteGraph(arena, cities.size(), backwardRoutes, false);
+    auto searchFrom = [](const RouteGraph& local, int source) {
+        return deltaStepping(local, source, DistanceOnly(), 1);
+    };
+
+    vector<int32_t> boundaryTable(1, boundary.size());
+    for (int local : boundary) {
+        boundaryTable.push_back(cities[local]);
+    }
+    for (int local : boundary) {
+        vector<int> distance = searchFrom(forward, local);
+        for (int other : boundary) {
+            boundaryTable.push_back(distance[other]);
+        }
+    }
+
+    vector<int32_t> request, reply;
+    while (readMessage(socket, request) && !request.empty() && request[0] != ShardQuit) {
+        reply.clear();
+        if (request[0] == ShardBoundaryTable) {
+            reply = boundaryTable;
+        } else if (request[0] == ShardForward || request[0] == ShardBackward) {
+            vector<int> distance = searchFrom(request[0] == ShardForward ? forward : backward, localIndex[request[1]]);
+            for (int local : boundary) {
+                reply.push_back(distance[local]);
+            }
+        } else if (request[0] == ShardPair) {
+            reply.push_back(searchFrom(forward, localIndex[request[1]])[localIndex[request[2]]]);
+        }
+        if (!writeMessage(socket, reply)) {
+            break;
+        }
+    }
+    ::close(socket);
+}
+
+// Coordinator for a network split across shard processes. Cross-region queries run on an
+// overlay graph of boundary cities: intra-region boundary durations reported by the shards
+// plus the flights between regions.
+class ShardedRouter {
+    // Search policy for the overlay: each settled boundary city of the destination's region
+    // offers a route through its shard's backward durations; stop once nothing settled later
+    // can beat the best one
+    struct OverlaySearch : SearchDefaults {
+        const ShardedRouter& router;
+        int toRegion;
+        const vector<int32_t>& backward;
+        int best;
+
+        SearchStep settle(int node, int distance) {
+            if (distance >= best) {
+                return SearchStep::Stop;
+            }
+            int city = router.overlayCities[node];
+            if (router.regionOf[city] == toRegion) {
+                best = min(best, saturatingAdd(distance, int(backward[router.boundarySlot[node]])));
+            }
+            return SearchStep::Expand;
+        }
+    };
+
+public:
+    ShardedRouter() = default;
+    ShardedRouter(const ShardedRouter&) = delete;
+    ShardedRouter& operator=(const ShardedRouter&) = delete;
+    ~ShardedRouter() {
+        stop();
+    }
+
+    // Partition the network, start one shard process per region and build the overlay.
+    // This forks, and a child keeps only the forking thread: call it before the program starts
+    // any threads of its own. The shared WorkerPool's threads are joined here first.
+    bool start(const RouteGraph& graph, int numRegions) {
+        stop();
+        if (numRegions < 1 || !WorkerPool::shared().retireWorkers()) {
+            return false;
+        }
+        regionOf = partitionCities(graph, numRegions);
+        for (int region = 0; region < numRegions; region++) {
+            int sockets[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+                return false;
+            }
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+            int on = 1;
+            setsockopt(sockets[0], SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+            setsockopt(sockets[1], SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+            pid_t pid = fork();
+            if (pid < 0) {
+                return false;
+            }
+            if (pid == 0) {
+                ::close(sockets[0]);
+                for (int earlier : shardSockets) {
+                    ::close(earlier);
+                }
+                runShardProcess(sockets[1], graph, regionOf, region);
+                _exit(0);
+            }
+            ::close(sockets[1]);
+            shardSockets.push_back(sockets[0]);
+            shardPids.push_back(pid);
+        }
+
+        // Overlay: every region's boundary cities, linked by the shards' boundary tables
+        vector<Route> overlayRoutes;
+        overlayIndex.assign(graph.size(), -1);
+        boundaryCities.assign(numRegions, vector<int>());
+        vector<int32_t> reply;
+        for (int region = 0; region < numRegions; region++) {
+            if (!writeMessage(shardSockets[region], vector<int32_t>(1, ShardBoundaryTable)) || !readMessage(shardSockets[region], reply) ||
+                reply.empty() || reply[0] < 0 || reply.size() != 1 + size_t(reply[0]) * (1 + reply[0])) {
+                return false;
+            }
+            int numBoundary = reply[0];
+            for (int b = 0; b < numBoundary; b++) {
+                overlayIndex[reply[1 + b]] = overlayCities.size();
+                overlayCities.push_back(reply[1 + b]);
+                boundarySlot.push_back(b);
+                boundaryCities[region].push_back(reply[1 + b]);
+            }
+            const int32_t* table = &reply[1 + numBoundary];
+            for (int a = 0; a < numBoundary; a++) {
+                for (int b = 0; b < numBoundary; b++) {
+                    if (a != b && table[a * numBoundary + b] != INT_MAX) {
+                        overlayRoutes.push_back(Route{overlayIndex[reply[1 + a]], overlayIndex[reply[1 + b]], table[a * numBoundary + b]});
+                    }
+                }
+            }
+        }
+        for (int city = 0; city < graph.size(); city++) {
+            for (const auto& connection : graph.connections(city)) {
+                if (regionOf[city] != regionOf[connection.first]) {
+                    overlayRoutes.push_back(Route{overlayIndex[city], overlayIndex[connection.first], connection.second});
+                }
+            }
+        }
+        overlay = buildRouteGraph(overlayArena, overlayCities.size(), overlayRoutes, false);
+        running = true;
+        return true;
+    }
+
+    // Shortest flight time between two cities into result, INT_MAX if there is no path.
+    // Returns false if a shard did not answer; the router then stays down until restarted,
+    // since requests and replies on its sockets may no longer line up.
+    bool distance(int from, int to, int& result) {
+        if (!running) {
+            return false;
+        }
+        int fromRegion = regionOf[from];
+        int toRegion = regionOf[to];
+        vector<int32_t> forward, backward, sameRegion;
+
+        // Send every request before reading any reply, so both shards work at the same time
+        bool answered = writeMessage(shardSockets[fromRegion], vector<int32_t>{ShardForward, from}) &&
+                        writeMessage(shardSockets[toRegion], vector<int32_t>{ShardBackward, to}) &&
+                        (toRegion != fromRegion || writeMessage(shardSockets[toRegion], vector<int32_t>{ShardPair, from, to})) &&
+                        readMessage(shardSockets[fromRegion], forward) && readMessage(shardSockets[toRegion], backward) &&
+                        (toRegion != fromRegion || readMessage(shardSockets[toRegion], sameRegion));
+        if (!answered || forward.size() != boundaryCities[fromRegion].size() || backward.size() != boundaryCities[toRegion].size() ||
+            sameRegion.size() != (toRegion == fromRegion ? 1u : 0u)) {
+            running = false;
+            return false;
+        }
+        int best = sameRegion.empty() ? INT_MAX : sameRegion[0];
+
+        // Overlay search from the origin's boundary cities, stopping once it cannot improve
+        QueryPool& pool = queryPool();
+        vector<pair<int, int>> seeds = pool.pairs.acquire(0, make_pair(0, 0));
+        for (size_t b = 0; b < forward.size(); b++) {
+            seeds.push_back(make_pair(overlayIndex[boundaryCities[fromRegion][b]], int(forward[b])));
+        }
+        OverlaySearch search{{}, *this, toRegion, backward, best};
+        heapSearch(overlay, seeds.data(), seeds.size(), search);
+        pool.pairs.release(move(seeds));
+        result = search.best;
+        return true;
+    }
+
+    size_t numBoundaryCities() const {
+        return overlayCities.size();
+    }
+    size_t numOverlayConnections() const {
+        return overlay.numConnections();
+    }
+
+    // Process ids of the shards, one per region
+    const vector<pid_t>& shardProcesses() const {
+        return shardPids;
+    }
+
+    // Tell every shard to quit and wait for the processes to exit
+    void stop() {
+        running = false;
+        for (size_t shard = 0; shard < shardSockets.size(); shard++) {
+            writeMessage(shardSockets[shard], vector<int32_t>(1, ShardQuit)); // A shard that already exited just fails this
+            ::close(shardSockets[shard]);
+            waitpid(shardPids[shard], nullptr, 0);
+        }
+        shardSockets.clear();
+        shardPids.clear();
+        overlayCities.clear();
+        boundarySlot.clear();
+        overlay = RouteGraph();
+        overlayArena = MonotonicArena(); // Each start builds its overlay in a fresh arena
+    }
+
+private:
+    vector<int> regionOf;
+    vector<int> shardSockets;
+    vector<pid_t> shardPids;
+    vector<vector<int>> boundaryCities; // Per region, in the order its shard reports them
+    vector<int> overlayIndex;           // City -> overlay node, -1 if not a boundary city
+    vector<int> overlayCities;
+    vector<int> boundarySlot;           // Overlay node -> its position in boundaryCities of its region
+    MonotonicArena overlayArena;
+    RouteGraph overlay;
+    bool running = false;
+};
+#endif
+
+#endif // FINAL_H
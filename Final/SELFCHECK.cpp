@@ -0,0 +1,615 @@
+// FINAL self-check: runs every solver in FINAL.h, and the solvers of the earlier iterations,
+// on seeded random and adversarial networks and checks them against dijkstra.
+// Build with g++ -std=c++17 -O2 -pthread Final/SELFCHECK.cpp -o Final/SELFCHECK
+#include "FINAL.h"
+#include <climits>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// The solvers of the earlier iterations, compiled in with their mains renamed so the
+// self-check can hold them against the current ones. Every header they include is already
+// included above, so their #include lines expand to nothing inside the namespaces.
+#define main iterationMain
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+namespace firstIteration {
+#include "../1st Iter/Untitled-1.cpp"
+}
+namespace secondIteration {
+#include "../2nd Iter/Untitled-2.cpp"
+}
+namespace thirdIteration {
+#include "../3rd Iter/Untitled-3.cpp"
+}
+namespace matrixIteration {
+#include "Dijkastra.cpp"
+}
+#pragma GCC diagnostic pop
+#undef main
+
+// A generated network the self-check runs every solver on
+struct TestNetwork {
+    string name;
+    int numCities;
+    vector<Route> routes;
+    bool undirected;
+};
+
+// Function to generate seeded random and adversarial networks for the self-check
+vector<TestNetwork> generateTestNetworks(mt19937& rng) {
+    vector<TestNetwork> networks;
+    auto duration = [&]() { return int(rng() % 990 + 10); };
+
+    for (bool undirected : {true, false}) {
+        TestNetwork random = {undirected ? "random undirected" : "random directed", int(rng() % 200 + 2), {}, undirected};
+        int numRoutes = rng() % (random.numCities * 4);
+        for (int r = 0; r < numRoutes; r++) {
+            random.routes.push_back(Route{int(rng() % random.numCities), int(rng() % random.numCities), duration()});
+        }
+        networks.push_back(random);
+    }
+
+    // Main's network: every pair of cities connected
+    TestNetwork complete = {"complete", int(rng() % 29 + 1), {}, true};
+    for (int i = 0; i < complete.numCities; i++) {
+        for (int j = i + 1; j < complete.numCities; j++) {
+            complete.routes.push_back(Route{i, j, duration()});
+        }
+    }
+    networks.push_back(complete);
+
+    // Two islands and a few cities with no flights at all
+    TestNetwork disconnected = {"disconnected", 60, {}, rng() % 2 == 0};
+    for (int r = 0; r < 80; r++) {
+        int island = r % 2 == 0 ? 0 : 25;
+        disconnected.routes.push_back(Route{island + int(rng() % 25), island + int(rng() % 25), duration()});
+    }
+    networks.push_back(disconnected);
+
+    networks.push_back(TestNetwork{"single city", 1, {}, true});
+    networks.push_back(TestNetwork{"single city with self-loop", 1, {Route{0, 0, duration()}}, false});
+
+    TestNetwork chain = {"long chain", 400, {}, rng() % 2 == 0};
+    for (int i = 0; i + 1 < chain.numCities; i++) {
+        chain.routes.push_back(Route{i, i + 1, duration()});
+    }
+    networks.push_back(chain);
+
+    // Durations close to the sentinel: long paths must saturate to "no path", never wrap
+    TestNetwork huge = {"near-overflow durations", 24, {}, true};
+    for (int i = 0; i + 1 < huge.numCities; i++) {
+        huge.routes.push_back(Route{i, i + 1, INT_MAX / 8 + int(rng() % 1000)});
+        huge.routes.push_back(Route{i, int(rng() % huge.numCities), INT_MAX / 3 + int(rng() % 1000)});
+    }
+    networks.push_back(huge);
+
+    // Parallel flights between the same cities and flights back to the same city
+    TestNetwork parallel = {"parallel flights", 30, {}, rng() % 2 == 0};
+    for (int r = 0; r < 150; r++) {
+        int from = rng() % parallel.numCities;
+        parallel.routes.push_back(Route{from, r % 7 == 0 ? from : int(rng() % parallel.numCities), duration()});
+    }
+    networks.push_back(parallel);
+
+    // Flights that take no time, one of them the only way across
+    TestNetwork zero = {"zero-duration flights", 40, {}, rng() % 2 == 0};
+    for (int i = 0; i + 1 < zero.numCities; i++) {
+        zero.routes.push_back(Route{i, i + 1, i % 4 == 0 ? 0 : duration()});
+    }
+    for (int r = 0; r < 20; r++) {
+        zero.routes.push_back(Route{int(rng() % 20), int(rng() % 20), r % 2 == 0 ? 0 : duration()});
+    }
+    networks.push_back(zero);
+
+    return networks;
+}
+
+// Function to total the durations along a path, using the shortest flight for every leg.
+// Returns -1 if two consecutive cities have no flight between them.
+long long pathDuration(const RouteGraph& graph, const vector<int>& path) {
+    long long total = 0;
+    for (size_t i = 0; i + 1 < path.size(); i++) {
+        long long leg = -1;
+        for (const auto& connection : graph.connections(path[i])) {
+            if (connection.first == path[i + 1] && (leg == -1 || connection.second < leg)) {
+                leg = connection.second;
+            }
+        }
+        if (leg == -1) {
+            return -1;
+        }
+        total += leg;
+    }
+    return total;
+}
+
+// Function to follow a prev array back from end to start; returns an empty path if it breaks off
+vector<int> pathFromPrev(int start, int end, const vector<int>& prev) {
+    vector<int> path(1, end);
+    while (path.back() != start) {
+        int before = prev[path.back()];
+        if (before == -1 || path.size() > prev.size()) {
+            return vector<int>();
+        }
+        path.push_back(before);
+    }
+    reverse(path.begin(), path.end());
+    return path;
+}
+
+// How one of the earlier iterations' solvers did on a network
+struct IterationResult {
+    string solver;
+    bool matrixInput; // Takes the duration matrix, where 0 stands for "no flight"
+    bool supported;   // The network is one the solver was written for
+    bool agrees;
+};
+
+// Function to run the earlier iterations' solvers on a network and report, per solver,
+// whether it matched the reference rows from dijkstra for every source. None of them
+// saturate, so a network whose durations could wrap an int is not run at all.
+vector<IterationResult> compareIterationEngines(const RouteGraph& graph, const vector<int>& sources, const vector<vector<int>>& expected) {
+    int numCities = graph.size();
+    long long totalDuration = 0;
+    bool zeroDurations = false;
+    bool repeatedFlights = false; // Parallel flights or flights back to the same city
+    vector<int> lastSeen(numCities, -1);
+    for (int city = 0; city < numCities; city++) {
+        for (const auto& connection : graph.connections(city)) {
+            totalDuration += connection.second;
+            zeroDurations = zeroDurations || connection.second == 0;
+            repeatedFlights = repeatedFlights || connection.first == city || lastSeen[connection.first] == city;
+            lastSeen[connection.first] = city;
+        }
+    }
+    if (2 * totalDuration >= INT_MAX) {
+        return vector<IterationResult>();
+    }
+
+    // The matrix iterations keep the shortest flight per pair
+    vector<vector<int>> matrix(numCities, vector<int>(numCities, 0));
+    vector<secondIteration::City> secondCities(numCities);
+    vector<thirdIteration::City> thirdCities(numCities);
+    for (int city = 0; city < numCities; city++) {
+        for (const auto& connection : graph.connections(city)) {
+            int& cell = matrix[city][connection.first];
+            cell = cell == 0 ? connection.second : min(cell, connection.second);
+            secondCities[city].connections.push_back(connection);
+            thirdCities[city].connections.push_back(connection);
+        }
+    }
+
+    bool firstDijkstra = true, firstAstar = true, secondDijkstra = true, thirdDijkstra = true, matrixDijkstra = true;
+    for (size_t s = 0; s < sources.size(); s++) {
+        int start = sources[s];
+        firstDijkstra = firstDijkstra && firstIteration::dijkstra(matrix, start, start) == expected[s];
+        secondDijkstra = secondDijkstra && secondIteration::dijkstra(secondCities, start, start) == expected[s];
+        matrixDijkstra = matrixDijkstra && matrixIteration::dijkstra(matrix, start, start) == expected[s];
+
+        vector<int> prev(numCities, -1);
+        vector<int> distance = thirdIteration::dijkstra(thirdCities, start, start, prev);
+        for (int city = 0; city < numCities && distance == expected[s]; city++) {
+            if (distance[city] != INT_MAX && pathDuration(graph, pathFromPrev(start, city, prev)) != distance[city]) {
+                distance.clear();
+            }
+        }
+        thirdDijkstra = thirdDijkstra && distance == expected[s];
+
+        // A* stops at its destination, so only that entry is final
+        for (int end = 0; end < numCities; end += max(1, numCities / 4)) {
+            firstAstar = firstAstar && firstIteration::astar(matrix, start, end)[end] == expected[s][end];
+        }
+    }
+
+    // Known limits: the matrix cannot hold a zero-duration flight, A* steers by city index
+    // rather than a lower bound, the 1st floydWarshall never sets the diagonal to 0, and the
+    // later ones keep the last of several flights and let a self-loop overwrite the diagonal
+    vector<IterationResult> results = {{"1st iteration dijkstra", true, !zeroDurations, firstDijkstra},
+                                       {"1st iteration astar", true, false, firstAstar},
+                                       {"2nd iteration dijkstra", false, true, secondDijkstra},
+                                       {"3rd iteration dijkstra", false, true, thirdDijkstra},
+                                       {"Dijkastra.cpp dijkstra", true, !zeroDurations, matrixDijkstra}};
+
+    // The cubic solvers only run on the smaller networks to keep the self-check quick
+    if (numCities <= 200) {
+        vector<vector<int>> first = firstIteration::floydWarshall(matrix);
+        vector<vector<int>> second = secondIteration::floydWarshall(secondCities);
+        vector<vector<int>> thirdPrev(numCities, vector<int>(numCities, -1));
+        vector<vector<int>> third = thirdIteration::floydWarshall(thirdCities, thirdPrev);
+        bool firstFloyd = true, secondFloyd = true, thirdFloyd = true;
+        for (size_t s = 0; s < sources.size(); s++) {
+            firstFloyd = firstFloyd && first[sources[s]] == expected[s];
+            secondFloyd = secondFloyd && second[sources[s]] == expected[s];
+            thirdFloyd = thirdFloyd && third[sources[s]] == expected[s];
+        }
+        results.push_back({"1st iteration floydWarshall", true, false, firstFloyd});
+        results.push_back({"2nd iteration floydWarshall", false, !repeatedFlights, secondFloyd});
+        results.push_back({"3rd iteration floydWarshall", false, !repeatedFlights, thirdFloyd});
+    }
+    return results;
+}
+
+// Function to check that every solver agrees with dijkstra on generated networks.
+// Returns the number of failed checks.
+int runSelfCheck(int rounds, unsigned seed) {
+    mt19937 rng(seed);
+    long long numChecks = 0;
+    int numFailures = 0;
+    string networkName;
+    auto expect = [&](bool passed, const string& what) {
+        numChecks++;
+        if (!passed && ++numFailures <= 20) {
+            cout << "FAIL [" << networkName << "] " << what << endl;
+        }
+    };
+    // A reported path must start and end right and add up to the reported duration
+    auto validPath = [](const RouteGraph& graph, const vector<int>& path, int start, int end, int distance) {
+        if (distance == INT_MAX) {
+            return path.empty();
+        }
+        return !path.empty() && path.front() == start && path.back() == end && pathDuration(graph, path) == distance;
+    };
+    map<string, pair<int, int>> iterationTally; // Solver -> (networks agreed, networks run)
+
+    for (int round = 0; round < rounds; round++) {
+        for (const TestNetwork& network : generateTestNetworks(rng)) {
+            networkName = network.name + " #" + to_string(round);
+            int numCities = network.numCities;
+            MonotonicArena arena;
+            RouteGraph graph = buildRouteGraph(arena, numCities, network.routes, network.undirected);
+            bool zeroDurations = any_of(network.routes.begin(), network.routes.end(), [](const Route& route) { return route.duration == 0; });
+
+            vector<int> sources;
+            for (int city = 0; city < numCities; city++) {
+                if (numCities <= 40 || rng() % (numCities / 8) == 0) {
+                    sources.push_back(city);
+                }
+            }
+            vector<int> allCities(numCities);
+            for (int city = 0; city < numCities; city++) {
+                allCities[city] = city;
+            }
+
+            // Reference answers from the original O(V^2) dijkstra
+            vector<vector<int>> expected(sources.size());
+            for (size_t s = 0; s < sources.size(); s++) {
+                vector<int> prev(numCities, -1);
+                expected[s] = dijkstra(graph, sources[s], sources[s], prev);
+                for (int city = 0; city < numCities; city++) {
+                    vector<int> path = expected[s][city] == INT_MAX ? vector<int>() : pathFromPrev(sources[s], city, prev);
+                    expect(validPath(graph, path, sources[s], city, expected[s][city]), "dijkstra path");
+                }
+                for (int threads : {1, 3}) {
+                    vector<int> deltaPrev(numCities, -1);
+                    vector<int> distance = deltaStepping(graph, sources[s], deltaPrev, threads);
+                    expect(distance == expected[s] && (zeroDurations || deltaPrev == prev), "deltaStepping with " + to_string(threads) + " threads");
+                    for (int city = 0; city < numCities; city++) {
+                        vector<int> path = distance[city] == INT_MAX ? vector<int>() : pathFromPrev(sources[s], city, deltaPrev);
+                        expect(validPath(graph, path, sources[s], city, distance[city]), "deltaStepping path");
+                    }
+                }
+                expect(dijkstra(graph, sources[s], sources[s], DistanceOnly()) == expected[s], "distance-only dijkstra");
+                expect(deltaStepping(graph, sources[s], DistanceOnly(), 2) == expected[s], "distance-only deltaStepping");
+
+                // Narrow durations saturate: each must equal the int answer clamped to 16 bits
+                vector<uint16_t> clamped(numCities);
+                for (int city = 0; city < numCities; city++) {
+                    clamped[city] = clampDuration<uint16_t>(expected[s][city]);
+                }
+                expect(dijkstra<uint16_t>(graph, sources[s], sources[s], DistanceOnly()) == clamped, "dijkstra<uint16_t>");
+                expect(deltaStepping<uint16_t>(graph, sources[s], DistanceOnly(), 2) == clamped, "deltaStepping<uint16_t>");
+                expect(manyToMany<uint16_t>(graph, vector<int>(1, sources[s]), allCities, 1) == clamped, "manyToMany<uint16_t>");
+
+                vector<pair<int, int>> reachable = reachableWithin(graph, sources[s], INT_MAX - 1);
+                size_t numReachable = count_if(expected[s].begin(), expected[s].end(), [](int d) { return d != INT_MAX; });
+                bool sameReachable = reachable.size() == numReachable;
+                for (size_t i = 0; i < reachable.size() && sameReachable; i++) {
+                    sameReachable = expected[s][reachable[i].first] == reachable[i].second && (i == 0 || reachable[i - 1].second <= reachable[i].second);
+                }
+                expect(sameReachable, "reachableWithin");
+            }
+
+            // The earlier iterations must agree wherever the network is one they were written for,
+            // and the matrix ones must be caught dropping flights that take no time
+            for (const IterationResult& result : compareIterationEngines(graph, sources, expected)) {
+                if (result.supported) {
+                    expect(result.agrees, result.solver);
+                } else if (result.matrixInput && zeroDurations) {
+                    expect(!result.agrees, result.solver + " disagrees on zero-duration flights");
+                }
+                iterationTally[result.solver].first += result.agrees;
+                iterationTally[result.solver].second++;
+            }
+            vector<int> table = manyToMany(graph, sources, allCities, 2);
+            vector<vector<pair<int, int>>> batch = reachableWithinBatch(graph, sources, INT_MAX - 1, 2);
+            PathMatrix<int, uint16_t> compact = floydWarshall<int, uint16_t>(graph);
+            PathMatrix<long long, int32_t> wide = floydWarshall<long long, int32_t>(graph);
+            PathMatrix<uint16_t, uint8_t> narrow = floydWarshall<uint16_t, uint8_t>(graph);
+            expect(narrow.numCities == (PathMatrix<uint16_t, uint8_t>::fits(numCities) ? numCities : 0), "floydWarshall rejects cities beyond Index");
+            MappedAllPairs<int, uint16_t> persisted;
+            string tableFile = "selfcheck_all_pairs.bin";
+            uint64_t fingerprint = networkFingerprint(graph);
+            expect(saveAllPairs(compact, fingerprint, tableFile, 7) && persisted.open(tableFile, fingerprint), "saveAllPairs/MappedAllPairs open");
+
+            // A table is refused for another network, and a damaged header is refused even unverified
+            vector<Route> otherRoutes = network.routes;
+            otherRoutes.push_back(Route{0, 0, 1});
+            MonotonicArena otherArena;
+            uint64_t otherFingerprint = networkFingerprint(buildRouteGraph(otherArena, numCities, otherRoutes, network.undirected));
+            MappedAllPairs<int, uint16_t> refused;
+            expect(otherFingerprint != fingerprint && !refused.open(tableFile, otherFingerprint), "MappedAllPairs rejects another network");
+            {
+                fstream damaged(tableFile, ios::in | ios::out | ios::binary);
+                uint32_t badRowsPerBlock = 8;
+                damaged.seekp(offsetof(AllPairsHeader, rowsPerBlock));
+                damaged.write(reinterpret_cast<const char*>(&badRowsPerBlock), sizeof(badRowsPerBlock));
+            }
+            expect(!refused.open(tableFile, fingerprint, false), "MappedAllPairs rejects a damaged header");
+
+            // Unverified, a predecessor row that cycles or breaks off gives empty paths, never a hang
+            if (numCities > 1) {
+                string damagedFile = "selfcheck_damaged_pairs.bin";
+                MappedAllPairs<int, uint16_t> unverified;
+                saveAllPairs(compact, fingerprint, damagedFile, 7);
+                {
+                    AllPairsHeader header;
+                    ifstream(damagedFile, ios::binary).read(reinterpret_cast<char*>(&header), sizeof(header));
+                    size_t distOffset, prevOffset, fileSize;
+                    allPairsLayout(header, distOffset, prevOffset, fileSize);
+                    vector<uint16_t> badRow(numCities);
+                    for (int city = 0; city < numCities; city++) {
+                        badRow[city] = city % 2 == 0 ? PathMatrix<int, uint16_t>::noCity : 1;
+                    }
+                    fstream damaged(damagedFile, ios::in | ios::out | ios::binary);
+                    damaged.seekp(prevOffset);
+                    damaged.write(reinterpret_cast<const char*>(badRow.data()), badRow.size() * sizeof(uint16_t));
+                }
+                bool bounded = unverified.open(damagedFile, fingerprint, false);
+                for (int city = 0; city < numCities && bounded; city++) {
+                    vector<int> path = unverified.path(0, city);
+                    bounded = path.empty() || validPath(graph, path, 0, city, unverified.distance(0, city));
+                }
+                expect(bounded, "MappedAllPairs path survives a damaged predecessor block");
+                unverified = MappedAllPairs<int, uint16_t>();
+                remove(damagedFile.c_str());
+            }
+            ReorderedNetwork reordered = reorderNetwork(graph, computeCityOrder(graph, CityOrder::ReverseCuthillMcKee, vector<pair<double, double>>()));
+            HubLabels labels;
+            LandmarkOracle oracle;
+            expect(labels.build(graph) == isUndirected(graph) && (isUndirected(graph) || !network.undirected), "HubLabels refuses one-way flights");
+            bool oracleBuilt = oracle.build(graph, 4, 2);
+            expect(oracleBuilt == isUndirected(graph), "LandmarkOracle refuses one-way flights");
+            if (network.undirected) {
+
+                // A saved index maps back; one with a broken offset is rejected
+                string labelFile = "selfcheck_hub_labels.bin";
+                HubLabels reloaded;
+                expect(labels.save(labelFile) && reloaded.load(labelFile) && reloaded.numEntries() == labels.numEntries(), "HubLabels save/load");
+                if (numCities > 1) {
+                    fstream damaged(labelFile, ios::in | ios::out | ios::binary);
+                    uint64_t badOffset = labels.numEntries() + 1;
+                    damaged.seekp(24 + sizeof(uint64_t));
+                    damaged.write(reinterpret_cast<const char*>(&badOffset), sizeof(badOffset));
+                    damaged.close();
+                    expect(!reloaded.load(labelFile), "HubLabels rejects a damaged file");
+                }
+                remove(labelFile.c_str());
+            }
+
+            // Leg-limited routes must match dijkstra on the network without the longer flights
+            MaxLegDuration legLimit = {network.routes.empty() ? 0 : network.routes[rng() % network.routes.size()].duration};
+            vector<Route> shortRoutes;
+            for (const auto& route : network.routes) {
+                if (legLimit.allows(route.duration)) {
+                    shortRoutes.push_back(route);
+                }
+            }
+            MonotonicArena shortArena;
+            RouteGraph shortGraph = buildRouteGraph(shortArena, numCities, shortRoutes, network.undirected);
+
+            // Fewest flights must match dijkstra when every flight counts as one
+            vector<Route> unitRoutes = network.routes;
+            for (auto& route : unitRoutes) {
+                route.duration = 1;
+            }
+            MonotonicArena unitArena;
+            RouteGraph unitGraph = buildRouteGraph(unitArena, numCities, unitRoutes, network.undirected);
+            HopTable hopTable = minHopBatch(unitGraph, sources, true, 2);
+            for (size_t s = 0; s < sources.size(); s++) {
+                vector<int> hops = dijkstra(unitGraph, sources[s], 0, DistanceOnly());
+                for (int city = 0; city < numCities; city++) {
+                    int expectedHops = hops[city] == INT_MAX ? -1 : hops[city];
+                    expect(hopTable.hopCount(s, city) == expectedHops, "minHopBatch hop count");
+                    vector<int> path = hopTable.path(s, city);
+                    expect(validPath(unitGraph, path, sources[s], city, hops[city]), "minHopBatch path");
+                }
+            }
+#ifndef _WIN32
+            ShardedRouter router;
+            bool sharded = router.start(graph, 3);
+            expect(sharded, "ShardedRouter start");
+#endif
+
+            for (size_t s = 0; s < sources.size(); s++) {
+                int start = sources[s];
+                vector<int> reorderedPrev(numCities, -1);
+                vector<int> reorderedDistance = dijkstra(reordered.graph, reordered.toInternal[start], 0, reorderedPrev);
+                vector<int> legLimited = dijkstra(shortGraph, start, 0, DistanceOnly());
+                size_t numReachable = 0;
+                for (int city = 0; city < numCities; city++) {
+                    int distance = expected[s][city];
+                    numReachable += distance != INT_MAX;
+                    expect(table[s * numCities + city] == distance, "manyToMany");
+                    expect(compact.distance(start, city) == distance, "floydWarshall<int, uint16_t>");
+                    if (narrow.numCities == numCities) {
+                        expect(narrow.distance(start, city) == clampDuration<uint16_t>(distance), "floydWarshall<uint16_t, uint8_t>");
+                    }
+                    if (distance != INT_MAX) {
+                        expect(wide.distance(start, city) == distance, "floydWarshall<long long, int32_t>");
+                        vector<int> path(1, city);
+                        while (path.back() != start && path.size() <= size_t(numCities)) {
+                            path.push_back(compact.predecessor(start, path.back()));
+                        }
+                        reverse(path.begin(), path.end());
+                        expect(validPath(graph, path, start, city, distance), "floydWarshall path");
+                    }
+                    if (persisted.size() == numCities) {
+                        expect(persisted.distance(start, city) == distance, "MappedAllPairs distance");
+                        expect(validPath(graph, persisted.path(start, city), start, city, distance), "MappedAllPairs path");
+                    }
+                    expect(reorderedDistance[reordered.toInternal[city]] == distance, "reordered dijkstra");
+                    if (numCities <= 40 || city % 16 == 0) {
+                        vector<int> routePrev(numCities, -1);
+                        int routed = shortestRoute(graph, start, city, TrackPredecessors{routePrev}, NoGoal(), Unconstrained());
+                        expect(routed == distance && shortestRoute(graph, start, city, DistanceOnly(), NoGoal(), Unconstrained()) == distance, "shortestRoute distance");
+                        expect(validPath(graph, routed == INT_MAX ? vector<int>() : pathFromPrev(start, city, routePrev), start, city, distance), "shortestRoute path");
+                        expect(shortestRoute(graph, start, city, DistanceOnly(), NoGoal(), legLimit) == legLimited[city], "shortestRoute with MaxLegDuration");
+                        vector<int> goalPrev(numCities, -1);
+                        int guided = shortestRoute(graph, start, city, TrackPredecessors{goalPrev}, LandmarkGoal{oracle}, Unconstrained());
+                        if (oracleBuilt) {
+                            expect(guided == distance, "shortestRoute with LandmarkGoal");
+                            expect(validPath(graph, guided == INT_MAX ? vector<int>() : pathFromPrev(start, city, goalPrev), start, city, distance), "shortestRoute with LandmarkGoal path");
+                        } else {
+                            expect(guided == -1, "shortestRoute refuses LandmarkGoal on one-way flights");
+                        }
+                        expect(shortestRoute(reordered.graph, start, city, DistanceOnly(), LandmarkGoal{oracle}, Unconstrained()) == -1,
+                               "shortestRoute refuses LandmarkGoal on another graph");
+                    }
+#ifndef _WIN32
+                    if (sharded && (numCities <= 40 || city % 16 == 0)) {
+                        int routed;
+                        expect(router.distance(start, city, routed) && routed == distance, "ShardedRouter distance");
+                    }
+#endif
+                    // A refused oracle claims nothing: no upper bound, and 0 below
+                    expect(oracle.lowerBound(start, city) <= distance && distance <= oracle.estimate(start, city), "LandmarkOracle bounds");
+                    expect(oracleBuilt || (oracle.estimate(start, city) == (start == city ? 0 : INT_MAX) && oracle.lowerBound(start, city) == 0),
+                           "refused LandmarkOracle claims nothing");
+                    if (network.undirected) {
+                        expect(labels.distance(start, city) == distance, "hub label distance");
+                        expect(validPath(graph, labels.path(start, city), start, city, distance), "hub label path");
+                    }
+                }
+                bool sameBatch = batch[s].size() == numReachable;
+                for (const auto& entry : batch[s]) {
+                    sameBatch = sameBatch && expected[s][entry.first] == entry.second;
+                }
+                expect(sameBatch, "reachableWithinBatch");
+            }
+        }
+    }
+
+    // Names are stored once, codes find their airport, and renumbering keeps both with their city
+    networkName = "airport catalog";
+    {
+        NamePool pool;
+        uint32_t kochi = pool.intern("Kochi (COK)");
+        uint32_t chennai = pool.intern("Chennai (MAA)");
+        expect(pool.intern(string("Kochi (") + "COK)") == kochi && kochi != chennai && pool.size() == 2
+            && pool.arenaBytes() == 24 && pool.view(chennai) == "Chennai (MAA)", "NamePool interns each name once");
+
+        AirportCatalog airports = generateAirportCatalog(numBuiltinAirports + 10);
+        int hyderabad = airports.findByCode("HYD");
+        expect(hyderabad >= 0 && airports.name(hyderabad) == "Hyderabad (HYD)", "findByCode finds HYD");
+        expect(airports.findByCode("hyd") == -1 && airports.findByCode("XYZ") == -1 && airports.findByCode("HYDE") == -1,
+               "findByCode rejects unknown codes");
+        pair<double, double> location;
+        expect(findAirportLocation(packAirportCode("HYD"), location) && airports.locations[hyderabad] == location,
+               "catalog locates HYD");
+
+        size_t numNames = airports.names.size();
+        bool sameFlight = true;
+        for (int flight = 0; flight < 200; flight++) {
+            string_view name = airports.names.view(generateRandomFlightName(airports, hyderabad));
+            sameFlight = sameFlight && name.size() > 15 && name.substr(name.size() - 15) == "Hyderabad (HYD)";
+        }
+        expect(sameFlight && airports.names.size() <= numNames + 10, "flight names are interned once per airline");
+
+        vector<int> order(airports.size());
+        for (int city = 0; city < airports.size(); city++) {
+            order[city] = city;
+        }
+        shuffle(order.begin(), order.end(), rng);
+        MonotonicArena arena;
+        RouteGraph graph = buildRouteGraph(arena, airports.size(), vector<Route>());
+        ReorderedNetwork network = reorderNetwork(graph, order);
+        AirportCatalog renumbered = airports.reordered(order);
+        bool consistent = renumbered.size() == airports.size();
+        for (int city = 0; consistent && city < airports.size(); city++) {
+            int internal = network.toInternal[city];
+            consistent = renumbered.name(internal) == airports.name(city) && renumbered.locations[internal] == airports.locations[city];
+        }
+        for (const auto& airport : builtinAirports) {
+            consistent = consistent && renumbered.findByCode(airport.code) == network.toInternal[airports.findByCode(airport.code)];
+        }
+        expect(consistent, "reordered catalog follows toInternal");
+
+        unique_ptr<NetworkSnapshot> snapshot = buildSnapshot(airports, vector<Route>{Route{0, 1, 10}}, false);
+        expect(snapshot->graph.size() == airports.size() && snapshot->airports.findByCode("HYD") == hyderabad,
+               "buildSnapshot keeps the catalog");
+    }
+
+    // A retired snapshot is freed by its last reader, and acquire() fails once every slot is taken
+    networkName = "snapshot store";
+    {
+        SnapshotStore store;
+        vector<Route> routes = {Route{0, 1, 10}};
+        AirportCatalog airports = generateAirportCatalog(2);
+        store.publish(buildSnapshot(airports, routes, false));
+        {
+            SnapshotStore::ReadGuard reader = store.acquire();
+            store.publish(buildSnapshot(airports, routes, false));
+            expect(reader && reader->version == 1 && store.numPending() == 1, "SnapshotStore keeps a snapshot in use");
+        }
+        expect(store.waitForReclaim(chrono::milliseconds(1000)) && store.numReclaimed() == 1, "SnapshotStore reclaims after the last reader");
+        vector<SnapshotStore::ReadGuard> readers;
+        for (int r = 0; r < SnapshotStore::maxReaders; r++) {
+            readers.push_back(store.acquire());
+        }
+        expect(readers.back() && !store.acquire(), "SnapshotStore acquire fails when full");
+    }
+
+#ifndef _WIN32
+    // A shard that dies makes queries fail instead of taking the coordinator down with SIGPIPE
+    networkName = "sharded router";
+    {
+        vector<Route> routes;
+        for (int city = 0; city + 1 < 40; city++) {
+            routes.push_back(Route{city, city + 1, 10});
+        }
+        MonotonicArena arena;
+        RouteGraph graph = buildRouteGraph(arena, 40, routes);
+        ShardedRouter router;
+        int routed = -1;
+        expect(router.start(graph, 2) && router.distance(0, 39, routed) && routed == 390, "ShardedRouter answers");
+        if (!router.shardProcesses().empty()) {
+            pid_t shard = router.shardProcesses()[0];
+            kill(shard, SIGKILL);
+            waitpid(shard, nullptr, 0);
+        }
+        expect(!router.distance(0, 39, routed) && !router.distance(1, 2, routed), "ShardedRouter reports a dead shard");
+        expect(router.start(graph, 2) && router.distance(0, 39, routed) && routed == 390, "ShardedRouter restarts after a dead shard");
+        expect(!router.start(graph, 0) && !router.distance(0, 39, routed), "ShardedRouter refuses zero regions");
+    }
+#endif
+
+    remove("selfcheck_all_pairs.bin");
+    for (const auto& tally : iterationTally) {
+        cout << "Earlier iteration: " << tally.first << " agreed on " << tally.second.first << " of " << tally.second.second << " networks" << endl;
+    }
+    cout << "Self-check: " << numChecks << " checks, " << numFailures << " failures" << endl;
+    return numFailures;
+}
+
+// SELFCHECK [rounds] [seed]: exits non-zero when any check fails
+int main(int argc, char* argv[]) {
+    int rounds = argc > 1 ? atoi(argv[1]) : 20;
+    unsigned seed = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1;
+    return runSelfCheck(rounds, seed) == 0 ? 0 : 1;
+}